@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2023 Evan Bowman
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/. */
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "bench.hpp"
+
+
+
+#if not defined(__GBA__) and not defined(__NDS__)
+
+
+#include "platform/platform.hpp"
+#include "profile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+
+
+namespace bench
+{
+
+
+
+static bool running = false;
+static s64 simulated_us;
+static s64 duration_us;
+static u64 ticks;
+static s64 wall_start_ns;
+
+
+
+static s64 now_ns()
+{
+    namespace chrono = std::chrono;
+    auto clk = chrono::steady_clock::now().time_since_epoch();
+    return chrono::duration_cast<chrono::nanoseconds>(clk).count();
+}
+
+
+
+void begin(int minutes)
+{
+    simulated_us = 0;
+    duration_us = (s64)minutes * 60 * 1000000;
+    ticks = 0;
+    wall_start_ns = now_ns();
+
+    profile::reset_totals();
+    profile::set_totals_enabled(true);
+
+    running = true;
+}
+
+
+
+bool tick(Time delta)
+{
+    if (not running) {
+        return false;
+    }
+
+    simulated_us += delta;
+    ++ticks;
+
+    return simulated_us >= duration_us;
+}
+
+
+
+void report()
+{
+    running = false;
+
+    const s64 wall_ns = std::max(now_ns() - wall_start_ns, (s64)1);
+
+    char line[160];
+
+    snprintf(line,
+             sizeof line,
+             "bench: %.1f simulated seconds, %llu ticks in %.3f s "
+             "(%.0f ticks/sec, %.1fx realtime)",
+             simulated_us / 1e6,
+             (unsigned long long)ticks,
+             wall_ns / 1e9,
+             ticks / (wall_ns / 1e9),
+             (simulated_us * 1e3) / wall_ns);
+    info(line);
+
+    snprintf(line,
+             sizeof line,
+             "  %-24s %10s %7s %10s %9s",
+             "zone",
+             "total ms",
+             "% wall",
+             "calls",
+             "ns/call");
+    info(line);
+
+    profile::for_each_total([wall_ns](const profile::Totals& t) {
+        if (t.calls_ == 0) {
+            return;
+        }
+
+        char line[160];
+        snprintf(line,
+                 sizeof line,
+                 "  %-24s %10.2f %6.1f%% %10llu %9.0f",
+                 t.name_,
+                 t.total_ns_ / 1e6,
+                 (t.total_ns_ * 100.0) / wall_ns,
+                 (unsigned long long)t.calls_,
+                 (double)t.total_ns_ / t.calls_);
+        info(line);
+    });
+}
+
+
+
+} // namespace bench
+
+
+
+#endif
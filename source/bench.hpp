@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2023 Evan Bowman
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/. */
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "number/numeric.hpp"
+
+
+
+// Bookkeeping for the desktop build's --bench mode. The benchmark turns on the
+// profiler's running totals (see profile.hpp), and reports them for each
+// profile zone. The zones are inclusive: island updates include the projectile
+// updates, lisp eval may include gc pauses, etc., so the numbers in the report
+// won't add up to the total runtime.
+
+
+
+namespace bench
+{
+
+
+
+#if defined(__GBA__) or defined(__NDS__)
+
+
+
+inline void begin(int)
+{
+}
+
+
+
+inline bool tick(Time)
+{
+    return false;
+}
+
+
+
+inline void report()
+{
+}
+
+
+
+#else
+
+
+
+// Starts timing, and runs the benchmark for the given number of simulated
+// minutes.
+void begin(int minutes);
+
+
+
+// Advances the benchmark by one simulation tick. Returns true when the
+// benchmark has run for its full duration.
+bool tick(Time delta);
+
+
+
+// Logs per-zone timings and overall simulation throughput.
+void report();
+
+
+
+#endif
+
+
+
+} // namespace bench
@@ -15,87 +15,258 @@
 
 
 
-void compress(const Vector<char>& input, Vector<char>& output)
+// Feeds len bytes through the encoder, handing each block of encoded output to
+// emit(const u8*, u32).
+template <typename Emit>
+static void encode_span(heatshrink_encoder& enc,
+                        const u8* data,
+                        u32 len,
+                        Emit&& emit)
 {
-    struct Window
-    {
-        Buffer<char, 1000> input_;
-        Buffer<char, 1000> output_;
-    };
+    while (len) {
+        size_t bytes_sunk = 0;
+        heatshrink_encoder_sink(&enc, (u8*)data, len, &bytes_sunk);
 
-    auto win = allocate<Window>("compr-window");
+        data += bytes_sunk;
+        len -= bytes_sunk;
 
-    heatshrink_encoder enc;
-    heatshrink_encoder_reset(&enc);
+        u8 out_buf[256];
+        size_t bytes_read = 0;
+        HSE_poll_res res = HSER_POLL_MORE;
+        while (res == HSER_POLL_MORE) {
+            res = heatshrink_encoder_poll(&enc, out_buf, 256, &bytes_read);
+            emit(out_buf, bytes_read);
+        }
+    }
+}
+
+
+
+template <typename Emit>
+static void encode_finish(heatshrink_encoder& enc, Emit&& emit)
+{
+    auto fin = HSER_FINISH_DONE;
+    do {
+        fin = heatshrink_encoder_finish(&enc);
+        if (fin == HSER_FINISH_MORE) {
+            u8 out_buf[256];
+            size_t bytes_read = 0;
+            heatshrink_encoder_poll(&enc, out_buf, 256, &bytes_read);
+            emit(out_buf, bytes_read);
+        }
+    } while (fin not_eq HSER_FINISH_DONE);
+}
+
+
+
+template <typename Emit>
+static void decode_span(heatshrink_decoder& dec,
+                        const u8* data,
+                        u32 len,
+                        Emit&& emit)
+{
+    while (len) {
+        size_t bytes_sunk = 0;
+        auto sink_res =
+            heatshrink_decoder_sink(&dec, (u8*)data, len, &bytes_sunk);
 
-    for (auto it = input.begin(); it not_eq input.end(); ++it) {
-        if (win->input_.full()) {
-            compress_sink(enc, win->input_, win->output_);
-            for (char c : win->output_) {
-                output.push_back(c);
+        if (sink_res not_eq HSDR_SINK_OK) {
+            Platform::fatal("heatshrink invalid api usage");
+        }
+
+        data += bytes_sunk;
+        len -= bytes_sunk;
+
+        u8 out_buf[256];
+        size_t bytes_read = 0;
+        HSD_poll_res res = HSDR_POLL_MORE;
+        while (res == HSDR_POLL_MORE) {
+            res = heatshrink_decoder_poll(&dec, out_buf, 256, &bytes_read);
+
+            if (res == HSDR_POLL_ERROR_NULL or res == HSDR_POLL_ERROR_UNKNOWN) {
+                Platform::fatal("heatshrink api misuse");
             }
-            win->input_.clear();
-            win->output_.clear();
+
+            emit(out_buf, bytes_read);
         }
-        win->input_.push_back(*it);
     }
+}
+
+
 
-    if (not win->input_.empty()) {
-        compress_sink(enc, win->input_, win->output_);
-        for (char c : win->output_) {
-            output.push_back(c);
+template <typename Emit>
+static void decode_finish(heatshrink_decoder& dec, Emit&& emit)
+{
+    auto fin = HSDR_FINISH_DONE;
+    do {
+        fin = heatshrink_decoder_finish(&dec);
+        if (fin == HSDR_FINISH_MORE) {
+            u8 out_buf[256];
+            size_t bytes_read = 0;
+            heatshrink_decoder_poll(&dec, out_buf, 256, &bytes_read);
+            emit(out_buf, bytes_read);
         }
-        win->input_.clear();
-        win->output_.clear();
-    }
+    } while (fin not_eq HSDR_FINISH_DONE);
+}
 
-    compress_finish(enc, win->output_);
-    for (char c : win->output_) {
-        output.push_back(c);
-    }
+
+
+void compress(const Vector<char>& input, Vector<char>& output)
+{
+    heatshrink_encoder enc;
+    heatshrink_encoder_reset(&enc);
+
+    auto emit = [&](const u8* data, u32 len) {
+        output.append((const char*)data, len);
+    };
+
+    input.for_each_span([&](const char* data, u32 len) {
+        encode_span(enc, (const u8*)data, len, emit);
+    });
+
+    encode_finish(enc, emit);
 }
 
 
 
 void decompress(const Vector<char>& input, Vector<char>& output)
 {
-    struct Window
-    {
-        Buffer<char, 1000> input_;
-        Buffer<char, 1000> output_;
+    heatshrink_decoder dec;
+    heatshrink_decoder_reset(&dec);
+
+    // NOTE: the decoder's output goes straight into the output vector, so
+    // there's no limit on the compression ratio (previously, decoded data
+    // passed through a fixed-size window and anything beyond a ~4x ratio was
+    // silently truncated).
+    auto emit = [&](const u8* data, u32 len) {
+        output.append((const char*)data, len);
+    };
+
+    input.for_each_span([&](const char* data, u32 len) {
+        decode_span(dec, (const u8*)data, len, emit);
+    });
+
+    decode_finish(dec, emit);
+}
+
+
+
+// Worst case, heatshrink spends nine bits per literal byte, plus a few bytes
+// to flush the encoder.
+static constexpr const u32 compression_frame_bound =
+    compression_frame_size + compression_frame_size / 8 + 16;
+
+
+
+struct FrameWindow
+{
+    char input_[compression_frame_size];
+    char output_[compression_frame_bound];
+    u32 output_size_;
+};
+
+
+
+static void frame_header_store(Vector<char>& output, u16 raw, u16 stored)
+{
+    const char header[4] = {(char)(raw & 0xff),
+                            (char)(raw >> 8),
+                            (char)(stored & 0xff),
+                            (char)(stored >> 8)};
+
+    output.append(header, 4);
+}
+
+
+
+bool compress_frames(const Vector<char>& input, Vector<char>& output)
+{
+    auto win = allocate<FrameWindow>("compr-frame-window");
+
+    auto emit = [&](const u8* data, u32 len) {
+        if (win->output_size_ + len > compression_frame_bound) {
+            len = compression_frame_bound - win->output_size_;
+        }
+        memcpy(win->output_ + win->output_size_, data, len);
+        win->output_size_ += len;
     };
 
-    auto win = allocate<Window>("compr-window");
+    for (u32 offset = 0; offset < input.size();
+         offset += compression_frame_size) {
+
+        const u16 raw =
+            input.copy_out(offset, win->input_, compression_frame_size);
+
+        win->output_size_ = 0;
 
-    heatshrink_decoder enc;
-    heatshrink_decoder_reset(&enc);
+        heatshrink_encoder enc;
+        heatshrink_encoder_reset(&enc);
 
-    for (auto it = input.begin(); it not_eq input.end(); ++it) {
-        // NOTE: why size == 255? We want to make sure that the output buffer is
-        // large enough to hold the decompressed stuff. A greater than 4x
-        // compression ratio would be quite high for heatshrink...
-        if (win->input_.size() == 255) {
-            decompress_sink(enc, win->input_, win->output_);
-            for (char c : win->output_) {
-                output.push_back(c);
+        encode_span(enc, (const u8*)win->input_, raw, emit);
+        encode_finish(enc, emit);
+
+        if (win->output_size_ < raw) {
+            frame_header_store(output, raw, win->output_size_);
+            output.append(win->output_, win->output_size_);
+        } else {
+            if (offset == 0) {
+                // Probably incompressible data. Don't waste cycles on the rest.
+                return false;
             }
-            win->input_.clear();
-            win->output_.clear();
+            frame_header_store(output, raw, raw);
+            output.append(win->input_, raw);
         }
-        win->input_.push_back(*it);
-    }
 
-    if (not win->input_.empty()) {
-        decompress_sink(enc, win->input_, win->output_);
-        for (char c : win->output_) {
-            output.push_back(c);
+        if (output.size() >= input.size()) {
+            return false;
         }
-        win->input_.clear();
-        win->output_.clear();
     }
 
-    decompress_finish(enc, win->output_);
-    for (char c : win->output_) {
-        output.push_back(c);
+    return true;
+}
+
+
+
+void decompress_frames(const Vector<char>& input, Vector<char>& output)
+{
+    auto win = allocate<FrameWindow>("compr-frame-window");
+
+    auto emit = [&](const u8* data, u32 len) {
+        output.append((const char*)data, len);
+    };
+
+    u32 offset = 0;
+
+    while (offset < input.size()) {
+        u8 header[4];
+        if (input.copy_out(offset, (char*)header, 4) not_eq 4) {
+            return;
+        }
+        offset += 4;
+
+        const u16 raw = header[0] | (header[1] << 8);
+        const u16 stored = header[2] | (header[3] << 8);
+
+        if (raw > compression_frame_size or stored > raw) {
+            // Corrupt frame header.
+            return;
+        }
+
+        if (input.copy_out(offset, win->input_, stored) not_eq stored) {
+            // Truncated frame.
+            return;
+        }
+        offset += stored;
+
+        if (stored == raw) {
+            output.append(win->input_, raw);
+            continue;
+        }
+
+        heatshrink_decoder dec;
+        heatshrink_decoder_reset(&dec);
+
+        decode_span(dec, (const u8*)win->input_, stored, emit);
+        decode_finish(dec, emit);
     }
 }
@@ -30,6 +30,20 @@ void decompress(const Vector<char>& input, Vector<char>& output);
 
 
 
+// Frame-based compression. The input is split into frames of at most
+// compression_frame_size bytes, each encoded independently, and prefixed with
+// a four byte header holding the frame's raw and stored lengths (little endian
+// u16s). A frame that doesn't shrink is stored as-is. Because each frame
+// decodes into a bounded window, there's no limit on the input size.
+// compress_frames() returns false (leaving output in an unspecified state) when
+// the result would not be smaller than the input.
+static constexpr const u32 compression_frame_size = 768;
+
+bool compress_frames(const Vector<char>& input, Vector<char>& output);
+void decompress_frames(const Vector<char>& input, Vector<char>& output);
+
+
+
 template <u32 size>
 void compress_sink(heatshrink_encoder& enc,
                    const Buffer<char, size>& input,
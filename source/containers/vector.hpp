@@ -103,6 +103,34 @@ private:
     }
 
 
+    // Locates the slot one past the last element, allocating a new chunk if
+    // the final chunk is full.
+    void seek_end(Chunk*& current, int& size, ScratchBuffer::Tag t)
+    {
+        current = (Chunk*)data_->data_;
+        size = size_;
+
+        if (end_cache_) {
+            current = end_cache_;
+            size = end_chunk_size_;
+        } else {
+            seek_chunk(current, size);
+        }
+
+        if (size == (int)Chunk::elems()) {
+            // NOTE: pop_back() and clear() do not release chunks, so the
+            // cached end chunk may be full while a successor already exists.
+            if (not current->header_.next_) {
+                auto sbr = make_zeroed_sbr(t);
+                Chunk::initialize(sbr, current);
+                current->header_.next_ = sbr;
+            }
+            current = (Chunk*)(*current->header_.next_)->data_;
+            size = 0;
+        }
+    }
+
+
 public:
     struct Iterator
     {
@@ -325,61 +353,124 @@ public:
 
     void push_back(const T& elem, ScratchBuffer::Tag t = "")
     {
-        Chunk* current = (Chunk*)data_->data_;
+        Chunk* current;
+        int size;
+        seek_end(current, size, t);
 
-        int size = size_;
+        end_cache_ = current;
+        end_chunk_size_ = size + 1;
 
-        if (end_cache_) {
-            current = end_cache_;
-            size = end_chunk_size_;
-        } else {
-            seek_chunk(current, size);
-        }
+        new (current->array() + size) T(elem);
 
-        if (size == (int)Chunk::elems() and not current->header_.next_) {
-            auto sbr = make_zeroed_sbr(t);
-            Chunk::initialize(sbr, current);
-            current->header_.next_ = sbr;
-            current = (Chunk*)(*current->header_.next_)->data_;
-            size = 0;
-        }
+        ++size_;
+    }
+
+
+    template <typename... Args> void emplace_back(Args&&... args)
+    {
+        Chunk* current;
+        int size;
+        seek_end(current, size, data_->tag_);
 
         end_cache_ = current;
         end_chunk_size_ = size + 1;
 
-        new (current->array() + size) T(elem);
+        new (current->array() + size) T(std::forward<Args>(args)...);
 
         ++size_;
     }
 
 
-    template <typename... Args> void emplace_back(Args&&... args)
+    // Appends count elements, copying a whole chunk's worth at a time rather
+    // than pushing elements one by one. Intended for byte buffers (file
+    // contents, compressed data, etc.).
+    void append(const T* data, u32 count)
     {
-        Chunk* current = (Chunk*)data_->data_;
+        static_assert(std::is_trivially_copyable<T>());
 
-        int size = size_;
+        while (count) {
+            Chunk* current;
+            int size;
+            seek_end(current, size, data_->tag_);
 
-        if (end_cache_) {
-            current = end_cache_;
-            size = end_chunk_size_;
-        } else {
-            seek_chunk(current, size);
+            u32 span = Chunk::elems() - size;
+            if (span > count) {
+                span = count;
+            }
+
+            memcpy(current->array() + size, data, span * sizeof(T));
+
+            end_cache_ = current;
+            end_chunk_size_ = size + span;
+
+            size_ += span;
+            data += span;
+            count -= span;
         }
+    }
 
-        if (size == (int)Chunk::elems() and not current->header_.next_) {
-            auto sbr = make_zeroed_sbr(data_->tag_);
-            Chunk::initialize(sbr, current);
-            current->header_.next_ = sbr;
-            current = (Chunk*)(*current->header_.next_)->data_;
-            size = 0;
+
+    // Copies up to count elements, starting at offset, into dest. Returns the
+    // number of elements copied.
+    u32 copy_out(u32 offset, T* dest, u32 count) const
+    {
+        static_assert(std::is_trivially_copyable<T>());
+
+        if (offset >= size_) {
+            return 0;
         }
 
-        end_cache_ = current;
-        end_chunk_size_ = size + 1;
+        if (count > size_ - offset) {
+            count = size_ - offset;
+        }
 
-        new (current->array() + size) T(std::forward<Args>(args)...);
+        Chunk* current = (Chunk*)data_->data_;
+        int index = offset;
+        seek_chunk(current, index);
 
-        ++size_;
+        u32 remaining = count;
+        while (remaining) {
+            u32 span = Chunk::elems() - index;
+            if (span > remaining) {
+                span = remaining;
+            }
+
+            memcpy(dest, current->array() + index, span * sizeof(T));
+
+            dest += span;
+            remaining -= span;
+            index = 0;
+
+            if (remaining) {
+                current = (Chunk*)(*current->header_.next_)->data_;
+            }
+        }
+
+        return count;
+    }
+
+
+    // Invokes callback(const T* data, u32 count) for each contiguous run of
+    // elements, in order.
+    template <typename F> void for_each_span(F&& callback) const
+    {
+        Chunk* current = (Chunk*)data_->data_;
+        u32 remaining = size_;
+
+        while (remaining) {
+            u32 span = Chunk::elems();
+            if (span > remaining) {
+                span = remaining;
+            }
+
+            callback((const T*)current->array(), span);
+
+            remaining -= span;
+
+            if (remaining) {
+                current = (Chunk*)(*current->header_.next_)->data_;
+            }
+        }
     }
 
 
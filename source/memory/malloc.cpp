@@ -46,135 +46,411 @@ bool Heap::Sector::contains_address(void* addr) const
 
 bool Heap::Sector::empty() const
 {
-    return taken_.empty();
+    for (auto w : taken_) {
+        if (w) {
+            return false;
+        }
+    }
+    return true;
 }
 
 
 
-void Heap::Sector::free(Word* addr)
+int Heap::Sector::next_bit(int from, bool taken) const
 {
-    if (((intptr_t)addr) % sizeof(Word) not_eq 0) {
-        Platform::fatal(
-            format("free misaligned address! %", (intptr_t)addr).c_str());
+    int w = from / 32;
+    if (w >= bitmap_words) {
+        return word_count;
     }
 
-    --addr; // fetch size from slot -1
-    int count = *(int*)addr;
-    int start_index = addr - words_;
+    u32 bits = (taken ? taken_[w] : ~taken_[w]) & (~0u << (from % 32));
 
-    for (int i = start_index; i < start_index + count; ++i) {
-        if (not taken_.get(i)) {
-            Platform::fatal("heap corruption! (double free?)");
+    while (true) {
+        if (bits) {
+            return w * 32 + __builtin_ctz(bits);
         }
-        taken_.set(i, false);
+        if (++w == bitmap_words) {
+            return word_count;
+        }
+        bits = taken ? taken_[w] : ~taken_[w];
     }
 }
 
 
 
-void* Heap::Sector::try_alloc(u32 size, u32 flags)
+int Heap::Sector::find_free(int count) const
 {
-    if (size > (word_count + 1) * sizeof(Word)) {
-        Platform::fatal(
-            format("allocation of % exceeds max size!", size).c_str());
+    int i = next_bit(0, false);
+
+    while (i + count <= word_count) {
+        const int end = next_bit(i, true);
+        if (end - i >= count) {
+            return i;
+        }
+        i = next_bit(end, false);
+    }
+
+    return -1;
+}
+
+
+
+void Heap::Sector::mark(int start, int count, bool taken)
+{
+    while (count) {
+        const int bit = start % 32;
+        const int n = std::min(32 - bit, count);
+        const u32 mask = (n == 32) ? ~0u : ((1u << n) - 1) << bit;
+
+        if (taken) {
+            taken_[start / 32] |= mask;
+        } else {
+            taken_[start / 32] &= ~mask;
+        }
+
+        start += n;
+        count -= n;
+    }
+}
+
+
+
+int Heap::Sector::free_words() const
+{
+    int result = word_count;
+    for (auto w : taken_) {
+        result -= __builtin_popcount(w);
+    }
+    return result;
+}
+
+
+
+int Heap::Sector::largest_free_run() const
+{
+    int result = 0;
+
+    int i = next_bit(0, false);
+    while (i < word_count) {
+        const int end = next_bit(i, true);
+        result = std::max(result, end - i);
+        i = next_bit(end, false);
+    }
+
+    return result;
+}
+
+
+
+static int size_class(int words)
+{
+    for (int i = 0; i < Heap::size_class_count; ++i) {
+        if (Heap::size_classes[i] >= words) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+
+void* Heap::alloc_from(Sector& s, int sector_index, int words, bool permanent)
+{
+    const int index = s.find_free(words);
+    if (index == -1) {
+        return nullptr;
     }
 
+    s.mark(index, words, true);
+
+    stats_.words_in_use_ += words;
+    stats_.peak_words_ = std::max(stats_.peak_words_, stats_.words_in_use_);
+
+    Sector::Word* start = &s.words_[index];
+
+    if (permanent) {
+        // In permanent alloc mode, allocation size isn't stored, saving a few
+        // bytes.
+        return start;
+    }
+
+    Header hdr;
+    hdr.sector_ = sector_index;
+    hdr.words_ = words;
+    memcpy(start, &hdr, sizeof hdr);
+
+    return start + 1; // skip over the header
+}
+
+
+
+void* Heap::alloc(u32 size, u32 flags)
+{
     const bool permanent = flags & smf_permanent;
 
-    int required_words = size / sizeof(Word);
-    if (size % sizeof(Word)) {
+    int required_words = size / sizeof(Sector::Word);
+    if (size % sizeof(Sector::Word)) {
         ++required_words;
     }
     if (not permanent) {
-        // In permanent alloc mode, allocation size isn't stored, saving a few
-        // bytes.
-        ++required_words; // +1 for allocation size.
-    }
-
-    for (int i = 0; i < word_count; ++i) {
-        if (not taken_.get(i)) {
-            bool found = true;
-            for (int ii = i; ii < required_words; ++ii) {
-                if (ii == word_count) {
-                    return nullptr;
-                }
-                if (taken_.get(ii)) {
-                    found = false;
-                    break;
-                }
-            }
+        ++required_words; // +1 for the header.
+    }
+
+    if (required_words > Sector::word_count) {
+        Platform::fatal(
+            format("allocation of % exceeds max size!", size).c_str());
+    }
 
-            if (found) {
-                Word* start = &words_[i];
-                // Store allocation size in the first slot.
-                *(int*)(start) = required_words;
+    ++stats_.alloc_count_;
+
+    if (not permanent) {
+        auto cls = size_class(required_words);
+        if (cls not_eq -1) {
+            required_words = size_classes[cls];
 
-                if (not smf_permanent) {
-                    ++start; // inc result pointer, to skip over the size param.
-                }
+            if (auto block = free_lists_[cls]) {
+                free_lists_[cls] = *(Sector::Word**)(block + 1);
+                --free_list_length_[cls];
 
-                for (int ii = i; ii - i < required_words; ++ii) {
-                    taken_.set(ii, true);
-                }
+                Header hdr;
+                memcpy(&hdr, block, sizeof hdr);
+                hdr.words_ &= ~cached_flag;
+                memcpy(block, &hdr, sizeof hdr);
 
-                return start;
+                stats_.words_in_use_ += required_words;
+                stats_.peak_words_ =
+                    std::max(stats_.peak_words_, stats_.words_in_use_);
+                ++stats_.size_class_hits_;
+
+                return block + 1;
             }
         }
     }
 
+    for (u32 i = 0; i < sector_table_.size(); ++i) {
+        auto s = sector_table_[i];
+        if (auto p = alloc_from(*s, i, required_words, permanent)) {
+            return p;
+        }
+    }
+
+    if (sector_table_.full()) {
+        ++stats_.failed_;
+        return nullptr;
+    }
+
+    sectors_.emplace_back();
+    // NOTE: indexing rather than back(), end() is off by a chunk when the last
+    // chunk is exactly full, which, with sector-sized elements, is always.
+    auto& s = sectors_[sectors_.size() - 1];
+    for (auto& w : s.taken_) {
+        w = 0;
+    }
+    sector_table_.push_back(&s);
+
+    const int index = sector_table_.size() - 1;
+    if (auto p = alloc_from(s, index, required_words, permanent)) {
+        return p;
+    }
+
+    ++stats_.failed_;
     return nullptr;
 }
 
 
 
-} // namespace malloc_compat
+void Heap::free(void* ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
 
+    if (((intptr_t)ptr) % sizeof(Sector::Word) not_eq 0) {
+        Platform::fatal(
+            format("free misaligned address! %", (intptr_t)ptr).c_str());
+    }
 
+    auto block = (Sector::Word*)ptr - 1; // header lives in slot -1
 
-extern "C" {
+    Header hdr;
+    memcpy(&hdr, block, sizeof hdr);
 
+    if (hdr.sector_ >= sector_table_.size() or
+        not sector_table_[hdr.sector_]->contains_address(block)) {
+        Platform::fatal(
+            format("invalid address passed to free! %", (intptr_t)ptr)
+                .c_str());
+    }
 
+    auto& s = *sector_table_[hdr.sector_];
+    const int start_index = block - s.words_;
 
-#ifdef __GBA__
-void* skyland_malloc(u32 sz, u32 flags)
+    if (hdr.words_ & cached_flag or
+        s.next_bit(start_index, false) < start_index + hdr.words_) {
+        Platform::fatal("heap corruption! (double free?)");
+    }
+
+    ++stats_.free_count_;
+    stats_.words_in_use_ -= hdr.words_;
+
+    auto cls = size_class(hdr.words_);
+    if (cls not_eq -1 and size_classes[cls] == hdr.words_ and
+        free_list_length_[cls] < free_list_limit) {
+        hdr.words_ |= cached_flag;
+        memcpy(block, &hdr, sizeof hdr);
+        *(Sector::Word**)(block + 1) = free_lists_[cls];
+        free_lists_[cls] = block;
+        ++free_list_length_[cls];
+        return;
+    }
+
+    s.mark(start_index, hdr.words_, false);
+}
+
+
+
+void Heap::diagnostics(DiagnosticsCallback cb) const
 {
-    using namespace malloc_compat;
+    int free_words = 0;
+    int largest_run = 0;
+    int run_words = 0;
+
+    for (auto s : sector_table_) {
+        free_words += s->free_words();
+        const int run = s->largest_free_run();
+        largest_run = std::max(largest_run, run);
+        run_words += run;
+    }
 
-    if (not bound_heap_) {
-        return nullptr;
+    int cached_words = 0;
+    for (int i = 0; i < size_class_count; ++i) {
+        cached_words += free_list_length_[i] * size_classes[i];
     }
 
-    for (auto& s : bound_heap_->sectors_) {
-        if (auto p = s.try_alloc(sz, flags)) {
-            return p;
-        }
+    const int wordsize = sizeof(Sector::Word);
+
+    cb(format("heap sectors: % (max %)", sector_table_.size(), max_sectors)
+           .c_str());
+
+    cb(format("in use: % bytes (peak %), cached: % bytes",
+              stats_.words_in_use_ * wordsize,
+              stats_.peak_words_ * wordsize,
+              cached_words * wordsize)
+           .c_str());
+
+    cb(format("allocs: %, frees: %, size class hits: %, failed: %",
+              stats_.alloc_count_,
+              stats_.free_count_,
+              stats_.size_class_hits_,
+              stats_.failed_)
+           .c_str());
+
+    // Fragmentation: the share of free memory lying outside of each sector's
+    // largest contiguous free run. An allocation can't span sectors, so a
+    // heap of entirely empty sectors scores zero.
+    int fragmentation = 0;
+    if (free_words) {
+        fragmentation = 100 - (run_words * 100) / free_words;
     }
 
-    bound_heap_->sectors_.emplace_back();
+    cb(format("free: % bytes, largest run: % bytes, fragmentation: %/100",
+              free_words * wordsize,
+              largest_run * wordsize,
+              fragmentation)
+           .c_str());
+}
 
-    for (auto& s : bound_heap_->sectors_) {
-        if (auto p = s.try_alloc(sz, flags)) {
-            return p;
+
+
+void heap_diagnostics(Heap::DiagnosticsCallback cb)
+{
+    if (not bound_heap_) {
+        cb("no heap bound!");
+        return;
+    }
+
+    bound_heap_->diagnostics(cb);
+}
+
+
+
+void benchmark(Heap::DiagnosticsCallback cb)
+{
+    Heap heap;
+
+    static const int slot_count = 64;
+    void* slots[slot_count] = {};
+
+    u32 state = 2463534242u;
+    auto next = [&state] {
+        // xorshift32, so that each run replays the same workload.
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    static const int op_count = 4000;
+
+    const auto start = PLATFORM.delta_clock().sample();
+
+    for (int i = 0; i < op_count; ++i) {
+        auto& slot = slots[next() % slot_count];
+        if (slot) {
+            heap.free(slot);
+            slot = nullptr;
+        } else {
+            // Mostly small requests, like the ones that our third party
+            // libraries make, with an occasional large buffer.
+            const auto r = next();
+            const u32 size = (r % 8 == 0) ? 64 + r % 512 : 4 + r % 60;
+            slot = heap.alloc(size, smf_none);
         }
     }
 
-    return nullptr;
+    const auto stop = PLATFORM.delta_clock().sample();
+
+    cb(format("heap bench: % ops in %us",
+              op_count,
+              Platform::DeltaClock::duration(start, stop))
+           .c_str());
+
+    heap.diagnostics(cb);
+
+    for (auto& slot : slots) {
+        heap.free(slot);
+    }
 }
 
 
 
-void skyland_free(void* ptr)
+} // namespace malloc_compat
+
+
+
+extern "C" {
+
+
+
+#ifdef __GBA__
+void* skyland_malloc(u32 sz, u32 flags)
 {
     using namespace malloc_compat;
 
-    for (auto& s : bound_heap_->sectors_) {
-        if (s.contains_address(ptr)) {
-            s.free((Heap::Sector::Word*)ptr);
-            return;
-        }
+    if (not bound_heap_) {
+        return nullptr;
     }
 
-    Platform::fatal(format("invalid address passed to free! %", (intptr_t)ptr));
+    return bound_heap_->alloc(sz, flags);
+}
+
+
+
+void skyland_free(void* ptr)
+{
+    using namespace malloc_compat;
+
+    bound_heap_->free(ptr);
 }
 
 
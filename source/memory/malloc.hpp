@@ -11,9 +11,10 @@
 
 #pragma once
 
-#include "bitvector.hpp"
 #include "containers/vector.hpp"
+#include "function.hpp"
 #include "malloc.h"
+#include "memory/buffer.hpp"
 
 
 
@@ -38,6 +39,9 @@ struct Heap
     struct Sector
     {
         static const int word_count = 480;
+        static const int bitmap_words = word_count / 32;
+
+        static_assert(word_count % 32 == 0);
 
         struct Word
         {
@@ -47,7 +51,8 @@ struct Heap
             alignas(sizeof(void*)) u8 data_[sizeof(void*)];
         };
 
-        Bitvector<word_count> taken_;
+        // One bit per word, scanned 32 words at a time with ctz.
+        u32 taken_[bitmap_words];
         alignas(void*) Word words_[word_count];
 
 
@@ -57,18 +62,103 @@ struct Heap
         bool empty() const;
 
 
-        void free(Word* addr);
+        // Index of the first bit at or after from matching taken, or
+        // word_count if there is none.
+        int next_bit(int from, bool taken) const;
+
+
+        // Start index of the first run of count free words, or -1.
+        int find_free(int count) const;
+
+
+        void mark(int start, int count, bool taken);
+
+
+        int free_words() const;
+
+
+        int largest_free_run() const;
+    };
+
+
+    // Every freeable allocation is preceded by one header word, recording the
+    // owning sector (an index into sector_table_, so free() never searches),
+    // and the allocation's length in words, including the header.
+    struct Header
+    {
+        u16 sector_;
+        u16 words_;
+    };
+
+    static_assert(sizeof(Header) <= sizeof(Sector::Word));
+
+    // Set in Header::words_ while a block sits in a size class free list.
+    static const u16 cached_flag = 0x8000;
+
+
+    // Small allocations are rounded up to one of these lengths (in words,
+    // header included). Freed blocks of a class go onto a short free list, and
+    // get handed out again without touching a sector bitmap.
+    static constexpr const u16 size_classes[] = {2, 3, 4, 6, 8, 12, 16, 24};
+    static const int size_class_count =
+        sizeof(size_classes) / sizeof(size_classes[0]);
+    static const int free_list_limit = 8;
+
+    static constexpr const int max_sectors = 64;
 
 
-        void* try_alloc(u32 size, u32 flags);
+    void* alloc(u32 size, u32 flags);
+
+
+    void free(void* ptr);
+
+
+    struct Stats
+    {
+        u32 alloc_count_ = 0;
+        u32 free_count_ = 0;
+        u32 size_class_hits_ = 0;
+        u32 failed_ = 0;
+        u32 words_in_use_ = 0;
+        u32 peak_words_ = 0;
     };
 
+    const Stats& stats() const
+    {
+        return stats_;
+    }
+
+
+    using DiagnosticsCallback = Function<4 * sizeof(void*), void(const char*)>;
+
+
+    void diagnostics(DiagnosticsCallback cb) const;
+
+
     using Sectors = Vector<Sector>;
 
     Sectors sectors_;
+    Buffer<Sector*, max_sectors> sector_table_;
+    Sector::Word* free_lists_[size_class_count] = {};
+    u8 free_list_length_[size_class_count] = {};
+    Stats stats_;
     Heap* parent_ = nullptr;
+
+private:
+    void* alloc_from(Sector& s, int sector_index, int words, bool permanent);
 };
 
 
 
+// Print usage and fragmentation statistics for the active heap.
+void heap_diagnostics(Heap::DiagnosticsCallback cb);
+
+
+
+// Run a mixed-size alloc/free workload against a scratch heap, and report
+// throughput and the resulting fragmentation.
+void benchmark(Heap::DiagnosticsCallback cb);
+
+
+
 } // namespace malloc_compat
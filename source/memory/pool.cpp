@@ -61,6 +61,14 @@ void GenericPool::print_diagnostics()
         *output += remaining_str;
         *output += "\r\n";
 
+        if (auto high_water = pool->pooled_element_high_water()) {
+            *output += format("                    |  peak: %, exhausted: %",
+                              high_water,
+                              pool->pooled_exhaustion_count())
+                           .c_str();
+            *output += "\r\n";
+        }
+
         pool = pool->next();
     }
 
@@ -56,6 +56,19 @@ public:
     virtual u32 pooled_element_remaining() const = 0;
 
 
+    // Only tracked by pools that grow on demand. The most elements ever in use
+    // at once, and the number of allocations that failed for lack of space.
+    virtual u32 pooled_element_high_water() const
+    {
+        return 0;
+    }
+
+    virtual u32 pooled_exhaustion_count() const
+    {
+        return 0;
+    }
+
+
     const char* name() const
     {
         return name_;
@@ -74,6 +87,12 @@ public:
 
     static void print_diagnostics();
 
+protected:
+    void set_name(const char* name)
+    {
+        name_ = name;
+    }
+
 private:
     const char* name_;
     GenericPool* next_;
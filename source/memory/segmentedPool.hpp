@@ -108,6 +108,24 @@ public:
         return true;
     }
 
+
+    u32 elements_used() const
+    {
+        u32 result = 0;
+        for (auto& pl : pools_) {
+            result +=
+                pl->pooled_element_count() - pl->pooled_element_remaining();
+        }
+        return result;
+    }
+
+
+    u32 elements_total() const
+    {
+        return pools_.size() * objs_per_subpool;
+    }
+
+
     using PoolsBuffer = Buffer<DynamicMemory<Pool>, pool_count>;
     PoolsBuffer& pools()
     {
@@ -117,3 +135,202 @@ public:
 private:
     PoolsBuffer pools_;
 };
+
+
+
+// Like SegmentedPool, but allocates additional segments on demand (up to
+// max_segments), rather than failing when the initial segments fill up. All
+// segments share a single freelist, so alloc() and free() are O(1) regardless
+// of the number of segments. Intended for platforms with plenty of scratch
+// buffers to spare, i.e. not the gba.
+template <u32 max_obj_size,
+          u32 objs_per_segment,
+          u32 initial_segments,
+          u32 max_segments,
+          u32 align>
+class GrowableSegmentedPool : public GenericPool
+{
+public:
+    struct Cell
+    {
+        alignas(align) std::array<u8, max_obj_size> mem_;
+        Cell* next_;
+    };
+
+
+    struct Segment
+    {
+        Cell cells_[objs_per_segment];
+    };
+
+
+    // Growing the pool will never consume the last few scratch buffers.
+    static const int sbr_reserve = 16;
+
+
+    GrowableSegmentedPool(const char* name = "segmented-pool")
+        : GenericPool(name)
+    {
+    }
+
+
+    GrowableSegmentedPool(const GrowableSegmentedPool&) = delete;
+
+
+    static constexpr u32 element_size()
+    {
+        return max_obj_size;
+    }
+
+
+    static constexpr u32 alignment()
+    {
+        return align;
+    }
+
+
+    void create(const char* pool_label)
+    {
+        create(pool_label, initial_segments);
+    }
+
+
+    // NOTE: segment_count is only the initial size of the pool.
+    void create(const char* pool_label, u32 segment_count)
+    {
+        destroy();
+
+        set_name(pool_label);
+
+        for (u32 i = 0; i < segment_count; ++i) {
+            if (not grow()) {
+                Platform::fatal("pool init request invalid");
+            }
+        }
+    }
+
+
+    void destroy()
+    {
+        if (in_use_) {
+            Platform::fatal("attempt to destroy pool with outstanding "
+                            "references.");
+        }
+        segments_.clear();
+        freelist_ = nullptr;
+    }
+
+
+    void* alloc()
+    {
+        if (not freelist_ and not grow()) {
+            ++exhaustion_count_;
+            return nullptr;
+        }
+
+        auto cell = freelist_;
+        freelist_ = cell->next_;
+
+        if (++in_use_ > high_water_) {
+            high_water_ = in_use_;
+        }
+
+        return cell;
+    }
+
+
+    void free(void* e)
+    {
+        auto cell = (Cell*)e;
+        cell->next_ = freelist_;
+        freelist_ = cell;
+        --in_use_;
+    }
+
+
+    bool empty() const
+    {
+        return in_use_ == 0;
+    }
+
+
+    u32 elements_used() const
+    {
+        return in_use_;
+    }
+
+
+    u32 elements_total() const
+    {
+        return segments_.size() * objs_per_segment;
+    }
+
+
+    u32 pooled_element_size() const override
+    {
+        return max_obj_size;
+    }
+
+
+    u32 pooled_element_align() const override
+    {
+        return align;
+    }
+
+
+    u32 pooled_element_count() const override
+    {
+        return elements_total();
+    }
+
+
+    u32 pooled_element_remaining() const override
+    {
+        return elements_total() - in_use_;
+    }
+
+
+    u32 pooled_element_high_water() const override
+    {
+        return high_water_;
+    }
+
+
+    u32 pooled_exhaustion_count() const override
+    {
+        return exhaustion_count_;
+    }
+
+
+private:
+    bool grow()
+    {
+        if (segments_.full() or scratch_buffers_remaining() < sbr_reserve) {
+            return false;
+        }
+
+        auto segment = allocate<Segment>(name());
+        if (not segment) {
+            return false;
+        }
+
+        // Thread the freelist backwards, so that consecutive allocations
+        // proceed in address order.
+        for (int i = objs_per_segment - 1; i > -1; --i) {
+            auto& cell = segment->cells_[i];
+            cell.next_ = freelist_;
+            freelist_ = &cell;
+        }
+
+        segments_.push_back(std::move(segment));
+
+        return true;
+    }
+
+
+    Buffer<DynamicMemory<Segment>, max_segments> segments_;
+    Cell* freelist_ = nullptr;
+    u32 in_use_ = 0;
+    u32 high_water_ = 0;
+    u32 exhaustion_count_ = 0;
+};
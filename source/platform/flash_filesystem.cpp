@@ -8,6 +8,12 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#ifdef __TEST__
+#include <string.h>
+#include <string>
+#include <vector>
+#endif
+
 #include "string.hpp"
 
 
@@ -19,10 +25,11 @@
 // platform class for regression testing. See below for actual implementation.
 //
 // NOTE: to compile the unit tests:
-// g++ -std=c++17 flash_filesystem.cpp ../string.cpp ../../external/heatshrink/heatshrink_encoder.c ../../external/heatshrink/heatshrink_decoder.c -I ../ -I ../../external -g3 -D__FAKE_VECTOR__ -D__TEST__ -o fs_regression
+// g++ -std=c++17 flash_filesystem.cpp ../string.cpp ../skyland/sharedVariable.cpp ../../external/heatshrink/heatshrink_encoder.c ../../external/heatshrink/heatshrink_decoder.c -I ../ -I ../../external -g3 -D__TEST__ -o fs_regression
 
 
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
 
@@ -70,6 +77,12 @@ public:
                                       std::istreambuf_iterator<char>());
         data_ = contents;
 
+        if (data_.empty()) {
+            // No existing save file, start from a freshly erased 64kb flash
+            // sector.
+            data_.resize(64 * 1024, 0xff);
+        }
+
         // std::cout << "loaded data, size: " << data_.size() << std::endl;
     }
 
@@ -124,8 +137,45 @@ public:
     }
 
 
+    void flush_save_data()
+    {
+    }
+
+
+    void memset_words(void* dest, u8 byte, u32 word_count)
+    {
+        memset(dest, byte, word_count * sizeof(void*));
+    }
+
+
+    class DeltaClock
+    {
+    public:
+        using TimePoint = long long;
+
+        TimePoint sample() const
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        static long long duration(TimePoint t1, TimePoint t2)
+        {
+            return t2 - t1;
+        }
+    };
+
+
+    DeltaClock& delta_clock()
+    {
+        return delta_clock_;
+    }
+
+
 private:
     std::vector<uint8_t> data_;
+    DeltaClock delta_clock_;
 };
 
 
@@ -145,11 +195,18 @@ inline void error(const char* msg)
 {
     std::cerr << msg << std::endl;
 }
+void logic_error(const char* file, int line)
+{
+    std::cerr << "logic error, line " << line << ", file " << file
+              << std::endl;
+    exit(1);
+}
 
 
 #include "../compression.cpp"
 
 #include "../memory/pool.cpp"
+#include "../memory/sub_buffer.cpp"
 #include "scratch_buffer.cpp"
 
 #else
@@ -163,9 +220,9 @@ inline void error(const char* msg)
 
 
 
-#include "bloomFilter.hpp"
 #include "compression.hpp"
 #include "flash_filesystem.hpp"
+#include "fnv.hpp"
 
 
 
@@ -190,44 +247,6 @@ namespace flash_filesystem
 
 
 
-// FIXME: re-enable the file present filter. It breaks regression for some
-// reason... after working for years, it doesn't pass some of the test cases
-// that I wrote for it. Too bad...
-// static BloomFilter<512> file_present_filter;
-
-
-
-void __path_cache_insert(const char* path)
-{
-    // file_present_filter.insert(path, strlen(path));
-}
-
-
-
-void __path_cache_create()
-{
-    // file_present_filter.clear();
-
-    // walk([&](const char* path) { __path_cache_insert(path); });
-}
-
-
-
-void __path_cache_destroy()
-{
-    // file_present_filter.clear();
-}
-
-
-
-bool __path_cache_file_exists_maybe(const char* file_name)
-{
-    // return file_present_filter.exists(file_name, strlen(file_name));
-    return true;
-}
-
-
-
 static const u8 crc8_table[] = {
     0,   49,  98,  83,  196, 245, 166, 151, 185, 136, 219, 234, 125, 76,  31,
     46,  67,  114, 33,  16,  135, 182, 229, 212, 250, 203, 152, 169, 62,  15,
@@ -291,6 +310,11 @@ struct Record
 
             // The file data is compressed. Needs to be decompressed when read.
             compressed = (1 << 1),
+
+            // The file data is a sequence of compression frames, see
+            // compress_frames(). Older saves may still contain files in the
+            // legacy single-stream format, indicated by the compressed flag.
+            compressed_frames = (1 << 2),
         };
 
         u8 flags_[2];
@@ -333,6 +357,139 @@ static bool fs_lock = false;
 
 
 
+#ifndef FS_DIR_INDEX_SIZE
+#define FS_DIR_INDEX_SIZE 64
+#endif
+
+
+
+// An in-memory directory of the valid records in the log. Without it, every
+// file lookup needs to walk the whole log, reading each record header and file
+// name from flash. Entries are keyed by a hash of the path, but we still
+// compare the name stored in flash before trusting a match, so a collision
+// costs an extra read, not a wrong answer. If the filesystem holds more files
+// than the directory has room for, lookups fall back to scanning the log until
+// the next rebuild.
+struct DirEntry
+{
+    u32 path_hash_;
+    u32 offset_;
+    u16 data_length_;
+    u8 name_length_;
+    u8 flags_;
+};
+
+
+
+static Buffer<DirEntry, FS_DIR_INDEX_SIZE> dir_index;
+static bool dir_index_overflow = false;
+
+
+
+static u32 path_hash(const char* path, u32 path_len)
+{
+    return fnv32(path, path_len);
+}
+
+
+
+static void dir_index_insert(const char* path, u32 offset, const Record& r)
+{
+    if (r.file_info_.name_length_ > FS_MAX_PATH) {
+        // Can't be looked up by name, let the log scan deal with it.
+        dir_index_overflow = true;
+        return;
+    }
+
+    DirEntry e;
+    e.path_hash_ = path_hash(path, strlen(path));
+    e.offset_ = offset;
+    e.data_length_ = r.file_info_.data_length_.get();
+    e.name_length_ = r.file_info_.name_length_;
+    e.flags_ = r.file_info_.flags_[0];
+
+    if (not dir_index.push_back(e)) {
+        dir_index_overflow = true;
+    }
+}
+
+
+
+static void dir_index_erase(u32 offset)
+{
+    for (auto& e : dir_index) {
+        if (e.offset_ == offset) {
+            e = dir_index.back();
+            dir_index.pop_back();
+            return;
+        }
+    }
+}
+
+
+
+static const DirEntry* dir_index_find(const char* path)
+{
+    const auto path_len = strlen(path);
+    const auto hash = path_hash(path, path_len);
+
+    for (auto& e : dir_index) {
+        // NOTE: the stored name length includes a padding byte for
+        // odd-length paths.
+        if (e.path_hash_ not_eq hash or e.name_length_ < path_len or
+            e.name_length_ > path_len + 1) {
+            continue;
+        }
+
+        char file_name[FS_MAX_PATH + 1];
+        memset(file_name, 0, FS_MAX_PATH + 1);
+
+        PLATFORM.read_save_data(
+            &file_name, e.name_length_, e.offset_ + sizeof(Record));
+
+        if (str_eq(path, file_name)) {
+            return &e;
+        }
+    }
+
+    return nullptr;
+}
+
+
+
+static void dir_index_rebuild()
+{
+    dir_index.clear();
+    dir_index_overflow = false;
+
+    auto offset = start_offset + sizeof(Root);
+
+    while (true) {
+        Record r;
+        PLATFORM.read_save_data(&r, sizeof r, offset);
+
+        if (r.file_info_.name_length_ == 0xff) {
+            break;
+        }
+
+        if (r.invalidate_.get() == Record::InvalidateStatus::valid) {
+            char file_name[FS_MAX_PATH + 1];
+            memset(file_name, 0, FS_MAX_PATH + 1);
+
+            if (r.file_info_.name_length_ <= FS_MAX_PATH) {
+                PLATFORM.read_save_data(
+                    &file_name, r.file_info_.name_length_, offset + sizeof r);
+            }
+
+            dir_index_insert(file_name, offset, r);
+        }
+
+        offset += r.full_size();
+    }
+}
+
+
+
 struct AutoreleaseLock
 {
     bool has_lock_ = false;
@@ -365,8 +522,37 @@ struct AutoreleaseLock
 
 
 
+// Some platforms buffer save writes in memory, see
+// Platform::flush_save_data(). Commit them once the outermost filesystem
+// operation returns, rather than after each individual write.
+static int flush_depth = 0;
+
+
+
+struct AutoFlush
+{
+    AutoFlush()
+    {
+        ++flush_depth;
+    }
+
+
+    AutoFlush(const AutoFlush&) = delete;
+
+
+    ~AutoFlush()
+    {
+        if (--flush_depth == 0) {
+            PLATFORM.flush_save_data();
+        }
+    }
+};
+
+
+
 void destroy()
 {
+    AutoFlush flush;
     PLATFORM.erase_save_sector();
 }
 
@@ -451,6 +637,8 @@ InitStatus initialize(const InitConfig& conf)
         return initialized;
     }
 
+    AutoFlush flush;
+
     start_offset = offset;
 
     disk_capacity = PLATFORM.save_capacity();
@@ -464,7 +652,8 @@ InitStatus initialize(const InitConfig& conf)
 
         end_offset = start_offset + sizeof root;
 
-        __path_cache_create();
+        dir_index.clear();
+        dir_index_overflow = false;
 
         return initialized;
     }
@@ -537,10 +726,10 @@ InitStatus initialize(const InitConfig& conf)
     }
     if (reformat) {
         compact();
+    } else {
+        dir_index_rebuild();
     }
 
-    __path_cache_create();
-
     auto stat = [&] {
         info(format("flash fs init: begin: %, end: %, gaps: %",
                     start_offset,
@@ -645,6 +834,14 @@ int file_revisions(const char* path)
 
 int find_file(const char* path, Record& result)
 {
+    if (not dir_index_overflow) {
+        if (auto e = dir_index_find(path)) {
+            PLATFORM.read_save_data(&result, sizeof result, e->offset_);
+            return e->offset_;
+        }
+        return -1;
+    }
+
     auto offset = start_offset;
     offset += sizeof(Root);
 
@@ -687,8 +884,8 @@ int find_file(const char* path, Record& result)
 
 bool file_exists(const char* path)
 {
-    if (not __path_cache_file_exists_maybe(path)) {
-        return false;
+    if (not dir_index_overflow) {
+        return dir_index_find(path);
     }
 
     Record r;
@@ -699,19 +896,15 @@ bool file_exists(const char* path)
 
 void unlink_file(const char* path)
 {
+    AutoFlush flush;
+
     AutoreleaseLock guard;
     if (not guard.acquire()) {
         return;
     }
 
-    if (not __path_cache_file_exists_maybe(path)) {
-        return;
-    }
-
     Record r;
 
-    bool freed = false;
-
     auto off = find_file(path, r);
     while (off not_eq -1) {
         // NOTE: first byte of record holds invalidate bytes.
@@ -720,14 +913,10 @@ void unlink_file(const char* path)
         PLATFORM.write_save_data(&stat, 2, off);
 
         gap_space += r.full_size();
-        freed = true;
 
-        off = find_file(path, r);
-    }
+        dir_index_erase(off);
 
-    if (freed) {
-        __path_cache_destroy();
-        __path_cache_create();
+        off = find_file(path, r);
     }
 }
 
@@ -735,57 +924,56 @@ void unlink_file(const char* path)
 
 // Ok, now we need to copy every non-dead chunk in the filesystem into ram,
 // erase the flash sector, and write it back...
+//
+// NOTE: a flash erase clears the whole chip, so there's no way around holding
+// the live records in ram while we erase. But we read them in blocks, and we
+// don't keep a table of record boundaries: the write-back pass re-parses the
+// record headers from the staged data, so there's no limit on the file count.
 static void compact()
 {
     info("flash fs start compaction...");
 
-    Vector<char> data;
+    const auto start = PLATFORM.delta_clock().sample();
 
-    // FIXME: do not hard-code this size. file breaks should be some sort of
-    // list?
-    Buffer<u32, 100> breaks;
-
-    auto offset = start_offset;
-    offset += sizeof(Root);
-
-    while (true) {
-        Record r;
-        PLATFORM.read_save_data(&r, sizeof r, offset);
+    static constexpr const u32 block_size = 256;
 
-        if (r.file_info_.name_length_ == 0xff or offset >= end_offset) {
-            // uninitialized, as it holds the default flash erase value.
-            break;
-        }
+    static_assert(sizeof(Record) == sizeof(Record::FileInfo) + 2);
 
-        offset += sizeof r;
+    Vector<char> data;
 
-        char file_name[FS_MAX_PATH + 1];
-        memset(file_name, 0, FS_MAX_PATH + 1);
+    {
+        char block[block_size];
 
-        PLATFORM.read_save_data(&file_name, r.file_info_.name_length_, offset);
+        auto offset = start_offset;
+        offset += sizeof(Root);
 
-        if (r.invalidate_.get() == Record::InvalidateStatus::valid) {
+        while (offset < end_offset) {
+            Record r;
+            PLATFORM.read_save_data(&r, sizeof r, offset);
 
-            r.invalidate_.set(Record::InvalidateStatus::invalid);
-            static_assert(sizeof(Record) == sizeof(Record::FileInfo) + 2);
-            // NOTE: we don't want to ever write the first byte in the record,
-            // as we use this byte for invalidating entries. Keep track of the
-            // positions to avoid writing back after the erase operation.
-            breaks.push_back(data.size());
-            for (u32 i = 0; i < sizeof r; ++i) {
-                data.push_back(((u8*)&r)[i]);
-            }
-            for (int i = 0; i < r.file_info_.name_length_; ++i) {
-                data.push_back(file_name[i]);
+            if (r.file_info_.name_length_ == 0xff) {
+                // uninitialized, as it holds the default flash erase value.
+                break;
             }
-            offset += r.file_info_.name_length_;
-            for (u32 i = 0; i < r.file_info_.data_length_.get(); ++i) {
-                u8 val;
-                PLATFORM.read_save_data(&val, 1, offset++);
-                data.push_back(val);
+
+            if (r.invalidate_.get() == Record::InvalidateStatus::valid) {
+                // NOTE: we don't stage the invalidate bytes. We never want to
+                // write them back after the erase, as we use them later for
+                // invalidating the entry.
+                data.append((const char*)&r.file_info_, sizeof r.file_info_);
+
+                auto src = offset + sizeof r;
+                auto remaining = r.appended_size();
+                while (remaining) {
+                    const auto count = std::min(remaining, block_size);
+                    PLATFORM.read_save_data(block, count, src);
+                    data.append(block, count);
+                    src += count;
+                    remaining -= count;
+                }
             }
-        } else {
-            offset += r.appended_size();
+
+            offset += r.full_size();
         }
     }
 
@@ -794,8 +982,13 @@ static void compact()
 
     const auto start_align = start_offset + sizeof(Root);
 
+    // NOTE: We read in large blocks, but write back in the same small batches
+    // as batch_write(), as some carts disable interrupts for the duration of a
+    // write.
+    static constexpr const u32 write_batch_size = 64;
+
     u32 write_offset = start_align;
-    Buffer<u8, 64> buffer;
+    Buffer<u8, write_batch_size> buffer;
 
     auto flush = [&] {
         if (buffer.empty()) {
@@ -806,22 +999,31 @@ static void compact()
         buffer.clear();
     };
 
-
-    for (u32 i = 0; i < data.size(); ++i) {
-        if (i == breaks[0]) {
+    auto push = [&](u8 val) {
+        if (buffer.full()) {
             flush();
-            // Bump the write offset past the invalid designator bytes in the
-            // record header.
-            write_offset += 2;
-            breaks.erase(breaks.begin());
-            ++i; // Skip the next byte too.
-            static_assert(sizeof(Record) == sizeof(Record::FileInfo) + 2);
-        } else {
-            auto val = data[i];
-            if (buffer.full()) {
-                flush();
-            }
-            buffer.push_back(val);
+        }
+        buffer.push_back(val);
+    };
+
+    auto it = data.begin();
+    while (it not_eq data.end()) {
+        // Bump the write offset past the invalid designator bytes in the
+        // record header.
+        flush();
+        write_offset += sizeof(Record::invalidate_);
+
+        Record::FileInfo file_info;
+        for (u32 i = 0; i < sizeof file_info; ++i, ++it) {
+            ((u8*)&file_info)[i] = *it;
+            push(*it);
+        }
+
+        const u32 appended =
+            file_info.name_length_ + file_info.data_length_.get();
+
+        for (u32 i = 0; i < appended; ++i, ++it) {
+            push(*it);
         }
     }
 
@@ -833,47 +1035,62 @@ static void compact()
     Root root;
     init_root(root);
 
-    info("flash fs completed compaction!");
+    dir_index_rebuild();
+
+    const auto elapsed =
+        Platform::DeltaClock::duration(start, PLATFORM.delta_clock().sample());
+
+    info(format("flash fs completed compaction! moved % bytes in %us",
+                (u32)data.size(),
+                elapsed));
 }
 
 
 
-static int batch_write(u32& offset,
-                       Vector<char>::Iterator begin,
-                       Vector<char>::Iterator end)
+static int batch_write(u32& offset, const Vector<char>& data)
 {
-    constexpr int batch_size = 64;
-
-    Buffer<u8, batch_size> queue;
+    // NOTE: some carts disable interrupts for the duration of a write, so we
+    // still hand the data over in small batches, but directly out of the
+    // vector's chunks rather than through a staging buffer.
+    constexpr u32 batch_size = 64;
 
     int errors = 0;
 
-    auto flush = [&] {
-        if (queue.empty()) {
-            return;
+    auto write = [&](const char* src, u32 length) {
+        if (not PLATFORM.write_save_data(src, length, offset)) {
+            ++errors;
         }
-        bool success =
-            PLATFORM.write_save_data(queue.data(), queue.size(), offset);
+        offset += length;
+    };
 
-        if (not success) {
-            ++errors;
+    // NOTE: flash carts can only be written in halfwords, while a chunk's span
+    // may have an odd length. Carry the odd byte over into the next span.
+    char carry[2];
+    bool carrying = false;
+
+    data.for_each_span([&](const char* span, u32 length) {
+        if (carrying and length) {
+            carry[1] = *(span++);
+            --length;
+            write(carry, 2);
+            carrying = false;
         }
 
-        offset += queue.size();
-        queue.clear();
-    };
+        const u32 even = length & ~1;
+        for (u32 i = 0; i < even; i += batch_size) {
+            write(span + i, std::min(batch_size, even - i));
+        }
 
-    while (begin not_eq end) {
-        if (queue.full()) {
-            flush();
+        if (length & 1) {
+            carry[0] = span[even];
+            carrying = true;
         }
+    });
 
-        queue.push_back(*begin);
-        ++begin;
+    if (carrying) {
+        write(carry, 1);
     }
 
-    flush();
-
     return errors;
 }
 
@@ -888,18 +1105,21 @@ bool store_file_data(const char* path,
         return false;
     }
 
+    AutoFlush flush;
+
     // Append a new file to the end of the filesystem log.
 
-    Vector<char> comp_buffer;
-    if (opts.use_compression_) {
-        compress(file_data, comp_buffer);
-    }
+    // NOTE: the legacy compressor ran the whole file through one window and
+    // decoded in 255 byte slices into a fixed output buffer, so data with a
+    // high compression ratio overflowed the buffer and got truncated. Hence the
+    // old size limit. Framed compression has no such limit, and gives up early
+    // on data that won't shrink. Tiny files aren't worth the cycles.
+    static const u32 compression_min_size = 64;
 
+    Vector<char> comp_buffer;
     const bool compress_file =
-        opts.use_compression_ and
-        // FIXME: decompression code mysteriously doesn't work if the input
-        // buffer is larger than 2k...
-        file_data.chunks_used() < 2;
+        opts.use_compression_ and file_data.size() >= compression_min_size and
+        compress_frames(file_data, comp_buffer);
 
     auto& input = compress_file ? comp_buffer : file_data;
 
@@ -963,12 +1183,15 @@ bool store_file_data(const char* path,
     }
 
     u8 crc8 = 0;
-    for (char c : input) {
-        crc8 = crc8_table[((u8)c) ^ crc8];
-    }
+    input.for_each_span([&](const char* data, u32 length) {
+        for (u32 i = 0; i < length; ++i) {
+            crc8 = crc8_table[((u8)data[i]) ^ crc8];
+        }
+    });
 
     // info( format("calculated crc %", crc8));
 
+    const auto record_offset = end_offset;
     auto off = end_offset;
     static_assert(sizeof(Record) == sizeof(Record::FileInfo) + 2);
     ++off; // Skip the invalid bytes, which we don't want to write yet.
@@ -987,7 +1210,7 @@ bool store_file_data(const char* path,
         info.flags_[0] |= Record::FileInfo::Flags0::has_end_padding;
     }
     if (compress_file) {
-        info.flags_[0] |= Record::FileInfo::Flags0::compressed;
+        info.flags_[0] |= Record::FileInfo::Flags0::compressed_frames;
     }
 
     int write_errors = 0;
@@ -1007,11 +1230,13 @@ bool store_file_data(const char* path,
     off += path_total;
 
 
-    write_errors += batch_write(off, input.begin(), input.end());
+    write_errors += batch_write(off, input);
 
     end_offset = off;
 
-    __path_cache_insert(path);
+    Record r;
+    r.file_info_ = info;
+    dir_index_insert(path, record_offset, r);
 
     if (input_padding) {
         input.pop_back();
@@ -1038,7 +1263,10 @@ bool store_file_data(const char* path,
 
 u32 file_size(const char* path)
 {
-    if (not __path_cache_file_exists_maybe(path)) {
+    if (not dir_index_overflow) {
+        if (auto e = dir_index_find(path)) {
+            return e->data_length_;
+        }
         return 0;
     }
 
@@ -1056,10 +1284,6 @@ u32 file_size(const char* path)
 
 u32 read_file_data(const char* path, Vector<char>& output)
 {
-    if (not __path_cache_file_exists_maybe(path)) {
-        return 0;
-    }
-
     Record r;
 
     auto offset = find_file(path, r);
@@ -1070,23 +1294,32 @@ u32 read_file_data(const char* path, Vector<char>& output)
     offset += sizeof r;
     offset += r.file_info_.name_length_;
 
-    for (int i = 0; i < r.file_info_.data_length_.get(); ++i) {
-        char val;
-        PLATFORM.read_save_data(&val, 1, offset++);
-        output.push_back(val);
+    const u32 length = r.file_info_.data_length_.get();
+    char block[128];
+    for (u32 i = 0; i < length;) {
+        const u32 count = std::min<u32>(sizeof block, length - i);
+        PLATFORM.read_save_data(block, count, offset + i);
+        output.append(block, count);
+        i += count;
     }
 
     if (r.file_info_.flags_[0] & Record::FileInfo::Flags0::has_end_padding) {
         output.pop_back();
     }
 
-    if (r.file_info_.flags_[0] & Record::FileInfo::Flags0::compressed) {
+    const auto flags = r.file_info_.flags_[0];
+
+    if (flags & (Record::FileInfo::Flags0::compressed |
+                 Record::FileInfo::Flags0::compressed_frames)) {
         Vector<char> decomp;
-        decompress(output, decomp);
-        output.clear();
-        for (char c : decomp) {
-            output.push_back(c);
+        if (flags & Record::FileInfo::Flags0::compressed_frames) {
+            decompress_frames(output, decomp);
+        } else {
+            decompress(output, decomp);
         }
+        output.clear();
+        decomp.for_each_span(
+            [&](const char* data, u32 length) { output.append(data, length); });
     }
 
     return output.size();
@@ -1094,6 +1327,47 @@ u32 read_file_data(const char* path, Vector<char>& output)
 
 
 
+Optional<CompressionStats> compression_stats(const char* path)
+{
+    Record r;
+
+    auto offset = find_file(path, r);
+    if (offset == -1) {
+        return std::nullopt;
+    }
+
+    CompressionStats stats;
+    stats.stored_size_ = r.file_info_.data_length_.get();
+
+    const auto flags = r.file_info_.flags_[0];
+
+    if (flags & Record::FileInfo::Flags0::has_end_padding) {
+        --stats.stored_size_;
+    }
+
+    stats.raw_size_ = stats.stored_size_;
+
+    if (flags & Record::FileInfo::Flags0::compressed_frames) {
+        // Just sum up the frame headers, no need to decompress anything.
+        stats.raw_size_ = 0;
+        u32 frame_offset = offset + sizeof r + r.file_info_.name_length_;
+        const u32 end = frame_offset + stats.stored_size_;
+        while (frame_offset < end) {
+            u8 header[4];
+            PLATFORM.read_save_data(header, sizeof header, frame_offset);
+            stats.raw_size_ += header[0] | (header[1] << 8);
+            frame_offset += sizeof header + (header[2] | (header[3] << 8));
+        }
+    } else if (flags & Record::FileInfo::Flags0::compressed) {
+        Vector<char> contents;
+        stats.raw_size_ = read_file_data(path, contents);
+    }
+
+    return stats;
+}
+
+
+
 bool copy_file(const char* from_path, const char* to_path)
 {
     Vector<char> contents;
@@ -1171,6 +1445,8 @@ void reset()
     start_offset = 0;
     end_offset = 0;
     gap_space = 0;
+    dir_index.clear();
+    dir_index_overflow = false;
 }
 
 
@@ -1259,14 +1535,50 @@ bool persistence()
 
 
 
+// The harness starts out with a blank save, so the compaction tests write a
+// few files first, and overwrite or unlink some of them, to leave gaps for the
+// compaction to reclaim.
+static void seed_files()
+{
+    const char* names[] = {
+        "/a.dat", "/mods/b.lisp", "/save/c.dat", "/d.txt", "/e"};
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < 5; ++i) {
+            if (pass == 1 and i % 2) {
+                continue;
+            }
+            Vector<char> data;
+            for (int j = 0; j < 37 * (i + 1) + pass; ++j) {
+                data.push_back('a' + (j * 7 + i + pass) % 26);
+            }
+            store_file_data(names[i], data);
+        }
+    }
+
+    unlink_file("/d.txt");
+}
+
+
+
 bool compaction()
 {
     Buffer<std::pair<StringBuffer<68>, Vector<char>>, 9> files;
+    u32 expected_end;
 
     {
         Platform pfrm(".regr_input", ".regr_output");
         initialize({.offset_ = 8});
 
+        seed_files();
+
+        if (gap_space == 0) {
+            std::cerr << "seed files left no gaps!" << std::endl;
+            return false;
+        }
+
+        expected_end = end_offset - gap_space;
+
         walk([&files](const char* path) {
             files.emplace_back();
             files.back().first = path;
@@ -1300,7 +1612,7 @@ bool compaction()
     Platform pfrm(".regr_output", ".regr_output2");
     initialize({.offset_ = 8});
 
-    if (end_offset not_eq 1482) {
+    if (end_offset not_eq expected_end) {
         std::cerr << "end offset does not match expected!"
                   << " (" << end_offset << ")" << std::endl;
         return false;
@@ -1341,10 +1653,14 @@ bool write_triggered_compaction()
         test.push_back('A');
     }
 
+    u32 expected_end;
+
     {
         Platform pfrm(".regr_input", ".regr_output");
         initialize({.offset_ = 8});
 
+        seed_files();
+
         auto stats = statistics();
         std::cout << "bytes remaining " << stats.bytes_available_ << std::endl;
 
@@ -1359,6 +1675,8 @@ bool write_triggered_compaction()
             store_file_data("/stuff.dat", test);
         }
 
+        expected_end = end_offset;
+
         for (auto& kvp : files) {
             Vector<char> data;
             read_file_data(kvp.first.c_str(), data);
@@ -1383,7 +1701,7 @@ bool write_triggered_compaction()
     Platform pfrm(".regr_output", ".regr_output2");
     initialize({.offset_ = 8});
 
-    if (end_offset not_eq 2500) {
+    if (end_offset not_eq expected_end) {
         std::cerr << "end offset does not match expected! (" << end_offset
                   << ")" << std::endl;
         return false;
@@ -1414,6 +1732,236 @@ bool write_triggered_compaction()
 
 
 
+bool directory_index()
+{
+    Vector<char> data;
+    for (int i = 0; i < 33; ++i) {
+        data.push_back('c');
+    }
+
+    auto check = [&] {
+        if (not file_exists("/dir/a.dat") or file_exists("/dir/b.dat") or
+            not file_exists("/dir/c.dat") or file_exists("/dir/a")) {
+            std::cerr << "directory index existence mismatch!" << std::endl;
+            return false;
+        }
+
+        // NOTE: stored sizes include the halfword padding byte.
+        if (file_size("/dir/a.dat") not_eq 34 or
+            file_size("/dir/c.dat") not_eq 2) {
+            std::cerr << "directory index size mismatch!" << std::endl;
+            return false;
+        }
+
+        int count = 0;
+        walk([&](const char* path) {
+            Record r;
+            if (find_file(path, r) == -1) {
+                std::cerr << "walked file missing from index: " << path
+                          << std::endl;
+                return;
+            }
+            ++count;
+        });
+
+        return count == (int)dir_index.size() and not dir_index_overflow;
+    };
+
+    {
+        Platform pfrm(".regr_input", ".regr_output");
+        initialize({.offset_ = 8});
+
+        store_file_data("/dir/a.dat", data);
+        store_file_data("/dir/b.dat", data);
+        store_file_data("/dir/a.dat", data);
+        unlink_file("/dir/b.dat");
+
+        Vector<char> small;
+        small.push_back('x');
+        store_file_data("/dir/c.dat", small);
+
+        if (not check()) {
+            return false;
+        }
+
+        compact();
+
+        if (not check()) {
+            return false;
+        }
+    }
+
+    reset();
+    Platform pfrm(".regr_output", ".regr_output2");
+    initialize({.offset_ = 8});
+
+    return check();
+}
+
+
+
+bool compression_roundtrip()
+{
+    Platform pfrm(".regr_input", ".regr_output");
+    initialize({.offset_ = 8});
+
+    u32 seed = 7;
+    auto rand = [&] {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) & 0x7fff;
+    };
+
+    // Text-like data, runs long enough to compress by more than 4x (which
+    // broke the legacy decoder), and noise, which shouldn't compress at all.
+    const char* words[] = {"(defn ", "(let ((", "'(1 2 3) ", "room ", "\n  "};
+
+    for (int size : {10, 100, 700, 768, 769, 2100, 5000}) {
+        for (int kind = 0; kind < 3; ++kind) {
+            Vector<char> data;
+            while ((int)data.size() < size) {
+                if (kind == 0) {
+                    for (const char* w = words[rand() % 5]; *w; ++w) {
+                        data.push_back(*w);
+                    }
+                } else if (kind == 1) {
+                    data.push_back('a');
+                } else {
+                    data.push_back(rand());
+                }
+            }
+
+            store_file_data("/save/ctest.dat", data, {.use_compression_ = true});
+
+            Vector<char> result;
+            read_file_data("/save/ctest.dat", result);
+
+            if (result.size() not_eq data.size()) {
+                std::cerr << "size mismatch! " << size << " " << kind << " "
+                          << result.size() << std::endl;
+                return false;
+            }
+
+            for (u32 i = 0; i < data.size(); ++i) {
+                if (result[i] not_eq data[i]) {
+                    std::cerr << "byte mismatch! " << size << " " << kind
+                              << std::endl;
+                    return false;
+                }
+            }
+
+            auto stats = compression_stats("/save/ctest.dat");
+            if (not stats or stats->raw_size_ not_eq data.size() or
+                stats->stored_size_ > data.size()) {
+                std::cerr << "bad compression stats!" << std::endl;
+                return false;
+            }
+
+            std::cout << size << " " << kind << ": " << stats->stored_size_
+                      << std::endl;
+        }
+    }
+
+    return true;
+}
+
+
+
+bool vector_bulk_io()
+{
+    // Micro-benchmark for the chunk-wise Vector operations used by the
+    // filesystem and compressor, compared against per-byte access.
+    static const u32 payload_size = 32 * 1024;
+
+    static char payload[payload_size];
+    for (u32 i = 0; i < payload_size; ++i) {
+        payload[i] = i * 7 + (i >> 9);
+    }
+
+    Platform::DeltaClock clock;
+
+    auto throughput = [](long long usec) {
+        return usec ? (long long)payload_size * 1000000 / usec : 0;
+    };
+
+    auto t1 = clock.sample();
+    Vector<char> bytewise;
+    for (u32 i = 0; i < payload_size; ++i) {
+        bytewise.push_back(payload[i]);
+    }
+    auto t2 = clock.sample();
+    Vector<char> bulk;
+    bulk.append(payload, 100);
+    bulk.append(payload + 100, payload_size - 100);
+    auto t3 = clock.sample();
+
+    std::cout << "push_back: " << throughput(clock.duration(t1, t2))
+              << " bytes/s, append: " << throughput(clock.duration(t2, t3))
+              << " bytes/s" << std::endl;
+
+    static char out[payload_size];
+
+    t1 = clock.sample();
+    u32 index = 0;
+    for (char c : bulk) {
+        out[index++] = c;
+    }
+    t2 = clock.sample();
+    if (bulk.copy_out(0, out, payload_size) not_eq payload_size) {
+        return false;
+    }
+    t3 = clock.sample();
+
+    std::cout << "iterator: " << throughput(clock.duration(t1, t2))
+              << " bytes/s, copy_out: " << throughput(clock.duration(t2, t3))
+              << " bytes/s" << std::endl;
+
+    if (memcmp(out, payload, payload_size) not_eq 0) {
+        std::cerr << "copy_out mismatch!" << std::endl;
+        return false;
+    }
+
+    u32 offset = 0;
+    bool spans_match = true;
+    bytewise.for_each_span([&](const char* data, u32 length) {
+        spans_match = spans_match and
+                      memcmp(data, payload + offset, length) == 0;
+        offset += length;
+    });
+
+    if (not spans_match or offset not_eq payload_size) {
+        std::cerr << "span mismatch!" << std::endl;
+        return false;
+    }
+
+    // Partial reads straddling chunk boundaries.
+    for (u32 start : {0u, 1u, 2000u, 8000u, payload_size - 3}) {
+        char window[4096];
+        auto got = bulk.copy_out(start, window, sizeof window);
+        auto expect = std::min<u32>(sizeof window, payload_size - start);
+        if (got not_eq expect or memcmp(window, payload + start, got)) {
+            std::cerr << "partial copy_out mismatch!" << std::endl;
+            return false;
+        }
+    }
+
+    // Chunks are retained after clear(), so refilling the vector has to step
+    // into them rather than writing past the end of a full chunk.
+    bulk.clear();
+    for (u32 i = 0; i < payload_size; ++i) {
+        bulk.push_back(payload[payload_size - 1 - i]);
+    }
+    for (u32 i = 0; i < payload_size; ++i) {
+        if (bulk[i] not_eq payload[payload_size - 1 - i]) {
+            std::cerr << "refill mismatch!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
 void regression()
 {
     int pass_count = 0;
@@ -1437,6 +1985,9 @@ void regression()
     TEST_CASE(persistence);
     TEST_CASE(compaction);
     TEST_CASE(write_triggered_compaction);
+    TEST_CASE(directory_index);
+    TEST_CASE(compression_roundtrip);
+    TEST_CASE(vector_bulk_io);
 
     puts("");
     std::cout << pass_count << " tests passed" << std::endl;
@@ -119,6 +119,21 @@ u32 file_size(const char* path);
 
 
 
+struct CompressionStats
+{
+    // Bytes occupied by the file's data in the filesystem.
+    u32 stored_size_;
+
+    // Bytes after decompression. Equal to stored_size_ for uncompressed files.
+    u32 raw_size_;
+};
+
+
+
+Optional<CompressionStats> compression_stats(const char* path);
+
+
+
 inline u32 read_file_data_text(const char* path, Vector<char>& output)
 {
     auto read = read_file_data(path, output);
@@ -164,9 +179,7 @@ template <typename T> Optional<T> read_file_blob(const char* path)
     if (flash_filesystem::read_file_data_binary(path, data)) {
         if (data.size() == sizeof(T)) {
             T result;
-            for (u32 i = 0; i < data.size(); ++i) {
-                ((u8*)&result)[i] = data[i];
-            }
+            data.copy_out(0, (char*)&result, sizeof(T));
             return result;
         }
     }
@@ -178,10 +191,7 @@ template <typename T> Optional<T> read_file_blob(const char* path)
 template <typename T> bool write_file_blob(const char* path, const T& blob)
 {
     Vector<char> data;
-
-    for (u32 i = 0; i < sizeof blob; ++i) {
-        data.push_back(((u8*)&blob)[i]);
-    }
+    data.append((const char*)&blob, sizeof blob);
 
     return flash_filesystem::store_file_data_binary(path, data);
 }
@@ -194,9 +204,7 @@ inline bool store_file_data(const char* path,
                             const StorageOptions& opts = {})
 {
     Vector<char> buffer;
-    for (u32 i = 0; i < length; ++i) {
-        buffer.push_back(ptr[i]);
-    }
+    buffer.append(ptr, length);
     buffer.push_back('\0');
 
     return store_file_data_text(path, buffer, opts);
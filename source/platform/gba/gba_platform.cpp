@@ -3660,6 +3660,12 @@ bool Platform::write_save_data(const void* data, u32 length, u32 offset)
 }
 
 
+void Platform::flush_save_data()
+{
+    // Writes go straight to sram/flash.
+}
+
+
 bool Platform::read_save_data(void* buffer, u32 data_length, u32 offset)
 {
     if (get_gflag(GlobalFlag::save_using_flash)) {
@@ -380,6 +380,11 @@ public:
 
     void erase_save_sector();
 
+    // Commits buffered writes to the save media. The flash filesystem calls
+    // this at the end of each operation. A no-op on platforms that write
+    // through.
+    void flush_save_data();
+
 
 
     // For historical reasons, allows you to specify a folder and filename
@@ -978,6 +983,10 @@ public:
 
         void (*sprite_overlapping_supported)(bool& result);
         bool (*has_startup_opt)(const char* opt);
+
+        // Returns the argument following a startup option, or nullptr.
+        const char* (*startup_opt_arg)(const char* opt);
+
         void (*draw_point_light)(Fixnum x,
                                  Fixnum y,
                                  int radius,
@@ -1002,6 +1011,11 @@ public:
             bool include_background_ = false;
         };
         void (*quickfade)(u8 amount, ColorConstant k, QuickfadeConfig conf);
+
+        // Run the next frame's update, on platforms that can overlap it with
+        // presentation of the frame most recently passed to
+        // Screen::display(). Returns after both have finished.
+        void (*update_during_present)(Function<4 * sizeof(void*), void()>& fn);
     };
 
 
@@ -11,10 +11,13 @@
 #define WIN32_LEAN_AND_MEAN // Prevents windows.h from including winsock.h
 #define NOMINMAX            // Prevents windows.h from defining min/max macros
 
+#include "bitvector.hpp"
+#include "fnv.hpp"
 #include "number/random.hpp"
 #include "platform/conf.hpp"
 #include "platform/flash_filesystem.hpp"
 #include "platform/platform.hpp"
+#include "profile.hpp"
 #ifdef _WIN32
 #include <SDL.h>
 #include <SDL_image.h>
@@ -22,13 +25,20 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #endif
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <list>
 #include <map>
+#include <mutex>
 #include <queue>
 #include <sstream>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #if defined(__APPLE__)
 #include <mach-o/dyld.h> // for _NSGetExecutablePath
@@ -110,8 +120,6 @@ static bool window_size_initialized = false;
 static int last_window_width = 0;
 static int last_window_height = 0;
 
-static SDL_Texture* tile_recolor_buffer = nullptr;
-
 
 static int circle_effect_radius = 0;
 static int circle_effect_origin_x = 0;
@@ -362,7 +370,317 @@ struct RectInfo
 };
 
 
-std::vector<RectInfo> rect_draw_queue;
+// Rects and sprites are bucketed by priority (0-3) as they're submitted.
+std::vector<RectInfo> rect_draw_queue[4];
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Pipelined frames (--pipeline)
+//
+// SDL wants all rendering calls to come from the thread that created the
+// renderer, so rather than moving rendering off of the main thread, we move the
+// simulation. In pipelined mode, Screen::display() submits the frame's draw
+// calls but leaves the present pending. The next frame's update then runs on a
+// worker thread, while the main thread sits in SDL_RenderPresent() waiting for
+// vsync. Sprites and rects are already recorded into per-priority draw lists
+// as they're submitted, and display() consumes those lists before the worker
+// starts, so the two threads never touch the same game state. Platform calls
+// that have to run on the main thread (texture loads, event polling, mouse and
+// window queries, and nested clear()/display() calls made by scenes during an
+// update) get forwarded back to it when made from the worker (see
+// forward_to_render_thread()).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+static bool pipeline_enabled = false;
+static thread_local bool on_pipeline_worker = false;
+
+
+
+struct RenderThreadJob
+{
+    std::function<void()> fn_;
+    bool done_ = false;
+};
+
+
+
+struct FramePipeline
+{
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    Function<4 * sizeof(void*), void()>* update_ = nullptr;
+    bool update_done_ = false;
+    bool shutdown_ = false;
+
+    std::deque<RenderThreadJob*> render_jobs_;
+
+    // Set when display() defers SDL_RenderPresent() to the next update.
+    bool present_pending_ = false;
+
+    // Set while the main thread runs jobs forwarded by the worker.
+    bool servicing_ = false;
+
+    // See exit_game().
+    Optional<int> exit_code_;
+    bool exiting_ = false;
+    bool worker_parked_ = false;
+};
+
+static FramePipeline pipeline;
+
+
+
+static void pipeline_worker_main()
+{
+    on_pipeline_worker = true;
+
+    std::unique_lock<std::mutex> lock(pipeline.mutex_);
+
+    while (true) {
+        pipeline.cv_.wait(
+            lock, [] { return pipeline.update_ or pipeline.shutdown_; });
+
+        if (pipeline.shutdown_) {
+            return;
+        }
+
+        auto update = pipeline.update_;
+        lock.unlock();
+        (*update)();
+        lock.lock();
+
+        pipeline.update_ = nullptr;
+        pipeline.update_done_ = true;
+        pipeline.cv_.notify_all();
+    }
+}
+
+
+
+// Returns false if the caller is already on the main thread, and should just
+// carry on. Otherwise, runs fn on the main thread, and blocks until it's done.
+template <typename F> static bool forward_to_render_thread(F&& fn)
+{
+    if (not on_pipeline_worker) {
+        return false;
+    }
+
+    RenderThreadJob job{std::forward<F>(fn)};
+
+    std::unique_lock<std::mutex> lock(pipeline.mutex_);
+    pipeline.render_jobs_.push_back(&job);
+    pipeline.cv_.notify_all();
+    pipeline.cv_.wait(lock, [&] { return job.done_ or pipeline.exiting_; });
+
+    if (not job.done_) {
+        // The job called exit_game(), see below.
+        pipeline.worker_parked_ = true;
+        pipeline.cv_.notify_all();
+        lock.unlock();
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        }
+    }
+
+    return true;
+}
+
+
+
+static void pipeline_flush_present()
+{
+    if (pipeline.present_pending_) {
+        pipeline.present_pending_ = false;
+        SDL_RenderPresent(renderer);
+    }
+}
+
+
+
+[[noreturn]] static void exit_game(int code);
+
+
+
+static void update_during_present(Function<4 * sizeof(void*), void()>& update)
+{
+    if (not pipeline.present_pending_) {
+        update();
+        return;
+    }
+
+    if (not pipeline.worker_.joinable()) {
+        pipeline.worker_ = std::thread(pipeline_worker_main);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pipeline.mutex_);
+        pipeline.update_ = &update;
+        pipeline.update_done_ = false;
+    }
+    pipeline.cv_.notify_all();
+
+    pipeline_flush_present();
+
+    std::unique_lock<std::mutex> lock(pipeline.mutex_);
+
+    while (true) {
+        pipeline.cv_.wait(lock, [] {
+            return pipeline.update_done_ or not pipeline.render_jobs_.empty() or
+                   pipeline.exit_code_;
+        });
+
+        if (pipeline.exit_code_) {
+            lock.unlock();
+            exit_game(*pipeline.exit_code_);
+        }
+
+        while (not pipeline.render_jobs_.empty()) {
+            auto job = pipeline.render_jobs_.front();
+            pipeline.render_jobs_.pop_front();
+
+            lock.unlock();
+            pipeline.servicing_ = true;
+            job->fn_();
+            pipeline.servicing_ = false;
+            lock.lock();
+
+            job->done_ = true;
+            pipeline.cv_.notify_all();
+        }
+
+        if (pipeline.update_done_) {
+            return;
+        }
+    }
+}
+
+
+
+static void pipeline_shutdown()
+{
+    if (pipeline.worker_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(pipeline.mutex_);
+            pipeline.shutdown_ = true;
+        }
+        pipeline.cv_.notify_all();
+        pipeline.worker_.join();
+    }
+
+    pipeline_flush_present();
+}
+
+
+
+// NOTE: exit() runs static destructors, and the destructor of a still joinable
+// std::thread calls std::terminate(). So with --pipeline, we always exit from
+// the main thread, after the worker has either been joined, or parked somewhere
+// that won't touch the pipeline again.
+//
+// The worker asks the main thread to exit on its behalf. If the main thread
+// exits while the worker sits in forward_to_render_thread() (e.g. a fatal error
+// forwarded from an update), the worker gets parked first, and then detached.
+[[noreturn]] static void exit_game(int code)
+{
+    if (on_pipeline_worker) {
+        {
+            // NOTE: Notify while holding the lock, the main thread may destroy
+            // the condition variable as soon as it gets the lock back.
+            std::lock_guard<std::mutex> lock(pipeline.mutex_);
+            pipeline.exit_code_ = code;
+            pipeline.worker_parked_ = true;
+            pipeline.cv_.notify_all();
+        }
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        }
+    }
+
+    if (pipeline.worker_.joinable()) {
+        std::unique_lock<std::mutex> lock(pipeline.mutex_);
+        if (pipeline.update_) {
+            // The worker is in the middle of an update, blocked on us.
+            pipeline.exiting_ = true;
+            pipeline.cv_.notify_all();
+            pipeline.cv_.wait(lock, [] { return pipeline.worker_parked_; });
+            lock.unlock();
+            pipeline.worker_.detach();
+        } else {
+            lock.unlock();
+            pipeline_shutdown();
+        }
+    }
+
+    exit(code);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame time statistics (--frame-stats)
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+static bool frame_stats_enabled = false;
+static std::vector<Microseconds> frame_times;
+static Optional<std::chrono::steady_clock::time_point> last_frame_time;
+static const u32 frame_stats_interval = 600;
+
+
+
+static void frame_stats_report()
+{
+    if (frame_times.empty()) {
+        return;
+    }
+
+    std::sort(frame_times.begin(), frame_times.end());
+
+    auto percentile = [](int p) {
+        return frame_times[((frame_times.size() - 1) * p) / 100];
+    };
+
+    info(format("frame times over % frames (us): p50 %, p90 %, p99 %, max %",
+                frame_times.size(),
+                percentile(50),
+                percentile(90),
+                percentile(99),
+                frame_times.back()));
+
+    frame_times.clear();
+}
+
+
+
+static void frame_stats_sample()
+{
+    if (not frame_stats_enabled) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    if (last_frame_time) {
+        frame_times.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                now - *last_frame_time)
+                .count());
+
+        if (frame_times.size() == frame_stats_interval) {
+            frame_stats_report();
+        }
+    }
+
+    last_frame_time = now;
+}
+
 
 
 static const Platform::Extensions extensions{
@@ -426,6 +744,14 @@ static const Platform::Extensions extensions{
         }
         return false;
     },
+    .startup_opt_arg = [](const char* opt) -> const char* {
+        for (int i = 0; i < process_argc - 1; ++i) {
+            if (str_eq(process_argv[i], opt)) {
+                return process_argv[i + 1];
+            }
+        }
+        return nullptr;
+    },
     .draw_point_light =
         [](Fixnum x, Fixnum y, int radius, ColorConstant tint, u8 intensity) {
             if (radius <= 0 or intensity == 0) {
@@ -436,7 +762,10 @@ static const Platform::Extensions extensions{
         },
     .draw_rect =
         [](int x, int y, int w, int h, ColorConstant tint, int priority) {
-            rect_draw_queue.push_back({x, y, w, h, tint, priority});
+            if (priority >= 0 and priority < 4) {
+                rect_draw_queue[priority].push_back(
+                    {x, y, w, h, tint, priority});
+            }
         },
     .map_button =
         [](Button k, const char* button_name) {
@@ -461,7 +790,8 @@ static const Platform::Extensions extensions{
                 }
             }
             buttonmap[scancode] = k;
-        }};
+        },
+    .update_during_present = update_during_present};
 
 
 
@@ -683,6 +1013,20 @@ int main(int argc, char** argv)
                          "scripts, and then exit\n"
                       << " --no-window-system  Run a windowless instance of "
                          "the game\n"
+                      << " --mmap-save         Memory-map the save file, "
+                         "rather than buffering writes\n"
+                      << " --pipeline          Overlap each frame's update "
+                         "with presentation of the previous frame\n"
+                      << " --frame-stats       Periodically log frame time "
+                         "percentiles\n"
+                      << " --bench <script>    Run a level script with "
+                         "autopilot input, headless and uncapped, then log "
+                         "subsystem timings\n"
+                      << " --bench-minutes <n> Simulated minutes to run "
+                         "--bench for (default 5)\n"
+                      << " --profile           Time the game's hot paths, "
+                         "then log a summary and write profile_trace.json "
+                         "on exit\n"
                       << std::endl;
             return EXIT_SUCCESS;
         }
@@ -700,7 +1044,8 @@ int main(int argc, char** argv)
     int initial_height = logical_height * window_scale;
 
     if (not extensions.has_startup_opt("--regression") and
-        not extensions.has_startup_opt("--no-window-system")) {
+        not extensions.has_startup_opt("--no-window-system") and
+        not extensions.has_startup_opt("--bench")) {
         window = SDL_CreateWindow("Skyland",
                                   SDL_WINDOWPOS_UNDEFINED,
                                   SDL_WINDOWPOS_UNDEFINED,
@@ -731,20 +1076,32 @@ int main(int argc, char** argv)
 
         // Enable integer scaling for crisp pixels
         SDL_RenderSetIntegerScale(renderer, SDL_TRUE);
-
-        tile_recolor_buffer = SDL_CreateTexture(renderer,
-                                                SDL_PIXELFORMAT_RGBA8888,
-                                                SDL_TEXTUREACCESS_TARGET,
-                                                16,
-                                                16);
     }
 
     rng::critical_state = time(nullptr);
 
+    pipeline_enabled = renderer and extensions.has_startup_opt("--pipeline");
+    frame_stats_enabled = extensions.has_startup_opt("--frame-stats");
+
+    const bool profiling = extensions.has_startup_opt("--profile");
+    if (profiling) {
+        profile::set_enabled(true);
+    }
+
     Platform& pf = Platform::create();
 
     start(pf);
 
+    pipeline_shutdown();
+    frame_stats_report();
+
+    if (profiling) {
+        profile::report([](const char* line) { info(line); });
+        if (profile::dump_trace("profile_trace.json")) {
+            info("wrote profile_trace.json");
+        }
+    }
+
     if (renderer) {
         SDL_DestroyRenderer(renderer);
     }
@@ -778,9 +1135,9 @@ void Platform::restart()
     // Fork and exec
     if (fork() == 0) {
         execl(path, path, NULL);
-        exit(1); // If exec fails
+        _exit(1); // If exec fails
     }
-    exit(0);
+    exit_game(0);
 
 #elif defined(_WIN32)
     char path[MAX_PATH];
@@ -794,9 +1151,9 @@ void Platform::restart()
         CloseHandle(pi.hProcess);
         CloseHandle(pi.hThread);
     }
-    exit(0);
+    exit_game(0);
 #else
-    exit(EXIT_SUCCESS);
+    exit_game(EXIT_SUCCESS);
 #endif
 }
 
@@ -812,7 +1169,122 @@ struct TileInfo
 
 
 
-static std::map<Layer, std::map<std::pair<u16, u16>, TileInfo>> tile_layers_;
+// Each tile layer is a dense grid, large enough for the biggest map that the
+// gba hardware supports (map_0/map_1 are addressed at twice the resolution of
+// the 16x16 ext layers). A bitmap records which cells hold a tile, and a
+// bounding rect covers every cell written since the last clear, so that
+// drawing walks only the region of the grid that's actually in use.
+class TileLayer
+{
+public:
+    static constexpr int width = 64;
+    static constexpr int height = 64;
+
+
+    TileInfo* find(u16 x, u16 y)
+    {
+        if (x >= width or y >= height or not present_.get(x, y)) {
+            return nullptr;
+        }
+        return &tiles_[x][y];
+    }
+
+
+    TileInfo* assign(u16 x, u16 y, const TileInfo& info)
+    {
+        if (x >= width or y >= height) {
+            return nullptr;
+        }
+
+        if (not present_.get(x, y)) {
+            present_.set(x, y, true);
+            ++count_;
+
+            if (count_ == 1) {
+                x_min_ = x_max_ = x;
+                y_min_ = y_max_ = y;
+            } else {
+                x_min_ = std::min(x_min_, x);
+                x_max_ = std::max(x_max_, x);
+                y_min_ = std::min(y_min_, y);
+                y_max_ = std::max(y_max_, y);
+            }
+        }
+
+        tiles_[x][y] = info;
+        return &tiles_[x][y];
+    }
+
+
+    void erase(u16 x, u16 y)
+    {
+        if (find(x, y)) {
+            present_.set(x, y, false);
+            tiles_[x][y] = {};
+            --count_;
+        }
+    }
+
+
+    void clear()
+    {
+        if (count_ == 0) {
+            return;
+        }
+
+        for (int x = x_min_; x <= x_max_; ++x) {
+            for (int y = y_min_; y <= y_max_; ++y) {
+                tiles_[x][y] = {};
+            }
+        }
+        present_.clear();
+        count_ = 0;
+    }
+
+
+    bool empty() const
+    {
+        return count_ == 0;
+    }
+
+
+    // NOTE: visits tiles in column-major order, the same order in which the
+    // renderer used to draw them.
+    template <typename F> void for_each(F&& callback)
+    {
+        if (count_ == 0) {
+            return;
+        }
+
+        for (int x = x_min_; x <= x_max_; ++x) {
+            for (int y = y_min_; y <= y_max_; ++y) {
+                if (present_.get(x, y)) {
+                    callback(x, y, tiles_[x][y]);
+                }
+            }
+        }
+    }
+
+private:
+    TileInfo tiles_[width][height] = {};
+    Bitmatrix<width, height> present_;
+    int count_ = 0;
+    u16 x_min_ = 0;
+    u16 x_max_ = 0;
+    u16 y_min_ = 0;
+    u16 y_max_ = 0;
+};
+
+
+
+static TileLayer tile_layers_[(int)Layer::map_0_ext + 1];
+
+
+
+static TileLayer& tile_layer(Layer layer)
+{
+    return tile_layers_[(int)layer];
+}
 
 
 
@@ -831,9 +1303,8 @@ TileDesc Platform::get_tile(Layer layer, u16 x, u16 y)
         y %= 32;
     }
 
-    auto it = tile_layers_[layer].find({x, y});
-    if (it != tile_layers_[layer].end()) {
-        return it->second.tile_desc;
+    if (auto tile = tile_layer(layer).find(x, y)) {
+        return tile->tile_desc;
     }
     return 0;
 }
@@ -865,10 +1336,7 @@ void Platform::clear_layer(Layer layer)
         clear_layer(Layer::map_1);
     }
 
-    if (auto found = tile_layers_.find(layer);
-        found not_eq tile_layers_.end()) {
-        tile_layers_.erase(found);
-    }
+    tile_layer(layer).clear();
 }
 
 
@@ -879,47 +1347,34 @@ void Platform::set_tile(Layer layer,
                         TileDesc val,
                         Optional<u16> palette)
 {
-    auto erase_existing = [&](auto& layer, u16 x, u16 y) {
-        auto found_tile = layer.find({x, y});
-        if (found_tile not_eq layer.end()) {
-            layer.erase(found_tile);
-        }
+    auto erase_existing = [&](Layer layer, u16 x, u16 y) {
+        auto& tiles = tile_layer(layer);
+        tiles.erase(x * 2, y * 2);
+        tiles.erase(x * 2 + 1, y * 2);
+        tiles.erase(x * 2, y * 2 + 1);
+        tiles.erase(x * 2 + 1, y * 2 + 1);
     };
 
     switch (layer) {
-    case Layer::map_0_ext: {
-        auto found_layer = tile_layers_.find(Layer::map_0);
-        if (found_layer not_eq tile_layers_.end()) {
-            // On GBA hardware, map_0_ext is just a special addressing mode that
-            // treats tiles in the map_0 layer as 16x16 blocks of 2x2
-            // metatiles. Therefore, when we write to map_0_ext, we erase the
-            // overlapping contents of map_0, because the game assumes that
-            // they're effectively the same tile layer.
-            erase_existing(found_layer->second, x * 2, y * 2);
-            erase_existing(found_layer->second, x * 2 + 1, y * 2);
-            erase_existing(found_layer->second, x * 2, y * 2 + 1);
-            erase_existing(found_layer->second, x * 2 + 1, y * 2 + 1);
-        }
-        tile_layers_[layer][{x, y}] = {val, palette.value_or(0)};
+    case Layer::map_0_ext:
+        // On GBA hardware, map_0_ext is just a special addressing mode that
+        // treats tiles in the map_0 layer as 16x16 blocks of 2x2
+        // metatiles. Therefore, when we write to map_0_ext, we erase the
+        // overlapping contents of map_0, because the game assumes that
+        // they're effectively the same tile layer.
+        erase_existing(Layer::map_0, x, y);
+        tile_layer(layer).assign(x, y, {val, palette.value_or(0)});
         break;
-    }
 
-    case Layer::map_1_ext: {
-        auto found_layer = tile_layers_.find(Layer::map_1);
-        if (found_layer not_eq tile_layers_.end()) {
-            erase_existing(found_layer->second, x * 2, y * 2);
-            erase_existing(found_layer->second, x * 2 + 1, y * 2);
-            erase_existing(found_layer->second, x * 2, y * 2 + 1);
-            erase_existing(found_layer->second, x * 2 + 1, y * 2 + 1);
-        }
-        tile_layers_[layer][{x, y}] = {val, palette.value_or(0)};
+    case Layer::map_1_ext:
+        erase_existing(Layer::map_1, x, y);
+        tile_layer(layer).assign(x, y, {val, palette.value_or(0)});
         break;
-    }
 
     case Layer::map_0:
     case Layer::map_1:
     case Layer::background:
-        tile_layers_[layer][{x, y}] = {val, palette.value_or(0)};
+        tile_layer(layer).assign(x, y, {val, palette.value_or(0)});
         break;
 
     case Layer::overlay:
@@ -929,7 +1384,7 @@ void Platform::set_tile(Layer layer,
         if (is_glyph(val)) {
             fg_color = default_fg_color();
         }
-        tile_layers_[layer][{x, y}] = {val, palette.value_or(0), fg_color};
+        tile_layer(layer).assign(x, y, {val, palette.value_or(0), fg_color});
         break;
     }
 }
@@ -944,6 +1399,11 @@ void Platform::Input::rumble(bool enabled)
 
 Optional<Vec2<int>> Platform::Input::check_mouse()
 {
+    Optional<Vec2<int>> result;
+    if (forward_to_render_thread([&] { result = check_mouse(); })) {
+        return result;
+    }
+
     if (not(SDL_GetWindowFlags(window) & SDL_WINDOW_MOUSE_FOCUS)) {
         return std::nullopt;
     }
@@ -972,6 +1432,12 @@ Optional<Vec2<int>> Platform::Input::check_mouse()
 
 const char* Platform::Input::check_button()
 {
+    // NOTE: SDL only lets us pump events from the main thread.
+    const char* result = nullptr;
+    if (forward_to_render_thread([&] { result = check_button(); })) {
+        return result;
+    }
+
     SDL_Event e;
     while (SDL_PollEvent(&e)) {
         switch (e.type) {
@@ -980,7 +1446,7 @@ const char* Platform::Input::check_button()
             break;
 
         case SDL_QUIT:
-            exit(1);
+            exit_game(1);
             break;
 
         default:
@@ -994,6 +1460,11 @@ const char* Platform::Input::check_button()
 
 void Platform::Input::poll()
 {
+    // NOTE: SDL only lets us pump events from the main thread.
+    if (forward_to_render_thread([this] { poll(); })) {
+        return;
+    }
+
     std::copy(std::begin(states_), std::end(states_), std::begin(prev_));
 
     SDL_Event e;
@@ -1308,38 +1779,274 @@ std::string get_save_file_path()
 
 
 
-int save_capacity = 32000;
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <filesystem>
+#include <vector>
 
 
 
-u8 save_buffer[32000];
+int save_capacity = 32000;
 
 
 
-int Platform::save_capacity()
-{
-    return ::save_capacity;
-}
+// Save writes land in memory, and we only record which byte ranges changed.
+// The dirty ranges get written back to disk when the filesystem calls
+// flush_save_data() at the end of an operation (and at exit). We used to
+// rewrite the whole save file on every call to write_save_data(), and the
+// flash filesystem writes in 64 byte batches, so storing a single file rewrote
+// the save file dozens of times.
+//
+// Small updates are patched into the existing file in place. The filesystem is
+// log-structured and checksums each record, so a torn append is detected and
+// discarded at startup. Large updates, e.g. after a compaction erases the
+// sector, are written to a temporary file and renamed over the save file
+// instead.
+//
+// With --mmap-save, the save buffer is a shared mapping of the save file, and
+// flushing just syncs the dirty pages.
+static u8 save_memory[32000];
+static u8* save_buffer = save_memory;
+static bool save_mmapped = false;
+static bool save_file_complete = false;
+static std::vector<std::pair<u32, u32>> save_dirty_ranges;
+static u64 save_bytes_written = 0;
 
 
 
-void Platform::erase_save_sector()
+static void mark_save_dirty(u32 begin, u32 end)
 {
-    memset(save_buffer, 0xff, sizeof save_buffer);
+    if (not save_dirty_ranges.empty() and
+        save_dirty_ranges.back().second == begin) {
+        // The common case: the filesystem appends to the log sequentially.
+        save_dirty_ranges.back().second = end;
+    } else {
+        save_dirty_ranges.push_back({begin, end});
+    }
 }
 
 
 
-bool Platform::write_save_data(const void* data, u32 length, u32 offset)
+static u32 coalesce_save_dirty_ranges()
 {
-    memcpy(save_buffer + offset, data, length);
+    auto& ranges = save_dirty_ranges;
 
-    std::ofstream out(get_save_file_path(),
-                      std::ios_base::out | std::ios_base::binary);
+    std::sort(ranges.begin(), ranges.end());
 
-    out.write((const char*)save_buffer, ::save_capacity);
+    u32 total = 0;
+    size_t out = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (out and ranges[i].first <= ranges[out - 1].second) {
+            ranges[out - 1].second =
+                std::max(ranges[out - 1].second, ranges[i].second);
+        } else {
+            ranges[out++] = ranges[i];
+        }
+    }
+    ranges.resize(out);
 
-    return true;
+    for (auto& r : ranges) {
+        total += r.second - r.first;
+    }
+
+    return total;
+}
+
+
+
+static bool save_file_replace()
+{
+    const auto path = get_save_file_path();
+    const auto tmp_path = path + ".tmp";
+
+#ifdef _WIN32
+    {
+        std::ofstream out(tmp_path,
+                          std::ios_base::out | std::ios_base::binary |
+                              std::ios_base::trunc);
+        out.write((const char*)save_buffer, ::save_capacity);
+        out.flush();
+        if (not out) {
+            return false;
+        }
+    }
+#else
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write(fd, save_buffer, ::save_capacity) == ::save_capacity and
+              fsync(fd) == 0;
+    close(fd);
+    if (not ok) {
+        return false;
+    }
+#endif
+
+    std::error_code err;
+    std::filesystem::rename(tmp_path, path, err);
+    if (err) {
+        return false;
+    }
+
+    save_bytes_written += ::save_capacity;
+    return true;
+}
+
+
+
+static bool save_file_patch()
+{
+    const auto path = get_save_file_path();
+
+#ifdef _WIN32
+    std::fstream out(path,
+                     std::ios_base::in | std::ios_base::out |
+                         std::ios_base::binary);
+    if (not out) {
+        return false;
+    }
+    for (auto& [begin, end] : save_dirty_ranges) {
+        out.seekp(begin);
+        out.write((const char*)save_buffer + begin, end - begin);
+        save_bytes_written += end - begin;
+    }
+    out.flush();
+    return (bool)out;
+#else
+    int fd = open(path.c_str(), O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = true;
+    for (auto& [begin, end] : save_dirty_ranges) {
+        const auto len = end - begin;
+        ok = ok and pwrite(fd, save_buffer + begin, len, begin) == (ssize_t)len;
+        save_bytes_written += len;
+    }
+    ok = ok and fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+
+
+#ifndef _WIN32
+static bool save_file_sync_mapped()
+{
+    const auto page = (u32)sysconf(_SC_PAGESIZE);
+
+    bool ok = true;
+    for (auto& [begin, end] : save_dirty_ranges) {
+        const auto page_begin = begin - begin % page;
+        ok = ok and msync(save_buffer + page_begin, end - page_begin, MS_SYNC) ==
+                        0;
+        save_bytes_written += end - begin;
+    }
+    return ok;
+}
+
+
+
+static bool save_file_map()
+{
+    int fd = open(get_save_file_path().c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) not_eq 0 or
+        (st.st_size < ::save_capacity and
+         ftruncate(fd, ::save_capacity) not_eq 0)) {
+        close(fd);
+        return false;
+    }
+
+    auto mem = mmap(nullptr,
+                    ::save_capacity,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED,
+                    fd,
+                    0);
+    close(fd);
+
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    save_buffer = (u8*)mem;
+    save_mmapped = true;
+    save_file_complete = true;
+
+    return true;
+}
+#endif
+
+
+
+void Platform::flush_save_data()
+{
+    if (save_dirty_ranges.empty()) {
+        return;
+    }
+
+    const auto dirty = coalesce_save_dirty_ranges();
+
+    bool ok = false;
+
+    if (save_mmapped) {
+#ifndef _WIN32
+        ok = save_file_sync_mapped();
+#endif
+    } else if (not save_file_complete or dirty > (u32)::save_capacity / 2) {
+        ok = save_file_replace();
+        save_file_complete = save_file_complete or ok;
+    } else {
+        ok = save_file_patch();
+        if (not ok) {
+            // Maybe someone deleted the save file while the game was running.
+            ok = save_file_replace();
+        }
+    }
+
+    if (not ok) {
+        error("failed to write save data!");
+        return;
+    }
+
+    save_dirty_ranges.clear();
+}
+
+
+
+int Platform::save_capacity()
+{
+    return ::save_capacity;
+}
+
+
+
+void Platform::erase_save_sector()
+{
+    memset(save_buffer, 0xff, ::save_capacity);
+    mark_save_dirty(0, ::save_capacity);
+}
+
+
+
+bool Platform::write_save_data(const void* data, u32 length, u32 offset)
+{
+    memcpy(save_buffer + offset, data, length);
+    mark_save_dirty(offset, offset + length);
+
+    return true;
 }
 
 
@@ -1552,9 +2259,8 @@ Platform& Platform::instance()
 
 void Platform::set_palette(Layer layer, u16 x, u16 y, u16 palette)
 {
-    auto it = tile_layers_[layer].find({x, y});
-    if (it != tile_layers_[layer].end()) {
-        it->second.palette = palette;
+    if (auto tile = tile_layer(layer).find(x, y)) {
+        tile->palette = palette;
     }
 }
 
@@ -1562,9 +2268,8 @@ void Platform::set_palette(Layer layer, u16 x, u16 y, u16 palette)
 
 u16 Platform::get_palette(Layer layer, u16 x, u16 y)
 {
-    auto it = tile_layers_[layer].find({x, y});
-    if (it != tile_layers_[layer].end()) {
-        return it->second.palette;
+    if (auto tile = tile_layer(layer).find(x, y)) {
+        return tile->palette;
     }
     return 0;
 }
@@ -1627,87 +2332,526 @@ void Platform::blit_t1_tile_to_texture(u16 from_index, u16 to_index, bool hard)
 
 
 
-void Platform::walk_filesystem(
-    Function<8 * sizeof(void*), void(const char* path)> callback)
+void Platform::walk_filesystem(
+    Function<8 * sizeof(void*), void(const char* path)> callback)
+{
+    std::vector<std::string> paths;
+
+    auto res_path = resource_path();
+    using recursive_directory_iterator =
+        std::filesystem::recursive_directory_iterator;
+    for (const auto& dirent : recursive_directory_iterator(res_path)) {
+        if (dirent.is_regular_file()) {
+            auto full_path = dirent.path().string();
+            if (full_path.size() and full_path[full_path.size() - 1] == '~') {
+                // Gah! It's an emacs temporary file...
+                continue;
+            }
+            // Remove resource_path() prefix to get relative path
+            if (full_path.size() > res_path.size() &&
+                full_path.substr(0, res_path.size()) == res_path) {
+                auto relative_path = full_path.substr(res_path.size());
+                // Remove leading path delimiter if present
+                if (!relative_path.empty() &&
+                    (relative_path[0] == '/' || relative_path[0] == '\\')) {
+                    relative_path = relative_path.substr(1);
+                }
+                relative_path = "/" + relative_path;
+                paths.push_back(relative_path);
+            }
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    for (auto& path : paths) {
+        callback(path.c_str());
+    }
+}
+
+
+
+struct GlyphCacheEntry
+{
+    std::string texture_name;
+    u16 offset_in_texture;
+    TileDesc vram_tile_index;
+    bool in_use;
+
+    // Neighbors in the recently-used list (slot indices, -1 for none).
+    s16 lru_prev_;
+    s16 lru_next_;
+};
+
+// Each slot in glyph_cache owns one tile in the overlay atlas, following the
+// base overlay tiles. Slots are looked up by (texture name, offset) through a
+// hash index. When every slot is taken, the least recently used glyph that
+// isn't currently displayed on the overlay gets evicted.
+static std::vector<GlyphCacheEntry> glyph_cache;
+static const int max_glyph_cache_size = 256;
+
+static std::unordered_map<u64, u16> glyph_cache_index;
+static std::vector<u16> glyph_cache_free_slots;
+static s16 glyph_lru_head = -1; // Most recently used.
+static s16 glyph_lru_tail = -1; // Least recently used.
+
+static struct GlyphCacheStats
+{
+    u32 hits_ = 0;
+    u32 misses_ = 0;
+    u32 evictions_ = 0;
+} glyph_cache_stats;
+
+
+
+static u64 glyph_cache_key(const char* texture_name, u16 offset)
+{
+    return ((u64)fnv32(texture_name, strlen(texture_name)) << 16) | offset;
+}
+
+
+
+static void glyph_lru_unlink(int slot)
+{
+    auto& entry = glyph_cache[slot];
+
+    if (entry.lru_prev_ not_eq -1) {
+        glyph_cache[entry.lru_prev_].lru_next_ = entry.lru_next_;
+    } else {
+        glyph_lru_head = entry.lru_next_;
+    }
+
+    if (entry.lru_next_ not_eq -1) {
+        glyph_cache[entry.lru_next_].lru_prev_ = entry.lru_prev_;
+    } else {
+        glyph_lru_tail = entry.lru_prev_;
+    }
+
+    entry.lru_prev_ = -1;
+    entry.lru_next_ = -1;
+}
+
+
+
+static void glyph_lru_push_front(int slot)
+{
+    auto& entry = glyph_cache[slot];
+
+    entry.lru_prev_ = -1;
+    entry.lru_next_ = glyph_lru_head;
+
+    if (glyph_lru_head not_eq -1) {
+        glyph_cache[glyph_lru_head].lru_prev_ = slot;
+    } else {
+        glyph_lru_tail = slot;
+    }
+
+    glyph_lru_head = slot;
+}
+
+
+
+// Drops a glyph from the index and the recently-used list. The caller decides
+// what to do with the slot.
+static void glyph_cache_drop(int slot)
+{
+    auto& entry = glyph_cache[slot];
+
+    glyph_cache_index.erase(glyph_cache_key(entry.texture_name.c_str(),
+                                            entry.offset_in_texture));
+    glyph_lru_unlink(slot);
+    entry.in_use = false;
+}
+
+
+
+static void glyph_cache_clear()
+{
+    glyph_cache_index.clear();
+    glyph_cache_free_slots.clear();
+
+    for (int slot = glyph_cache.size() - 1; slot >= 0; --slot) {
+        glyph_cache[slot].in_use = false;
+        glyph_cache[slot].lru_prev_ = -1;
+        glyph_cache[slot].lru_next_ = -1;
+        glyph_cache_free_slots.push_back(slot);
+    }
+
+    glyph_lru_head = -1;
+    glyph_lru_tail = -1;
+}
+
+
+
+// Returns a free slot, evicting the least recently used glyph if necessary, or
+// -1 if every cached glyph is currently on screen.
+static int glyph_cache_acquire_slot()
+{
+    if (not glyph_cache_free_slots.empty()) {
+        const int slot = glyph_cache_free_slots.back();
+        glyph_cache_free_slots.pop_back();
+        return slot;
+    }
+
+    if (glyph_cache.size() < max_glyph_cache_size) {
+        glyph_cache.push_back(GlyphCacheEntry{"", 0, 0, false, -1, -1});
+        return glyph_cache.size() - 1;
+    }
+
+    // NOTE: evicting a glyph that's still displayed would swap the character
+    // out from under the text on screen.
+    bool on_screen[max_glyph_cache_size] = {};
+    tile_layer(Layer::overlay).for_each([&](int, int, TileInfo& t) {
+        const int slot = t.tile_desc - overlay_base_tile_count;
+        if (slot >= 0 and slot < max_glyph_cache_size) {
+            on_screen[slot] = true;
+        }
+    });
+
+    for (int slot = glyph_lru_tail; slot not_eq -1;
+         slot = glyph_cache[slot].lru_prev_) {
+        if (not on_screen[slot]) {
+            glyph_cache_drop(slot);
+            ++glyph_cache_stats.evictions_;
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+
+
+bool is_glyph(TileDesc td)
+{
+    return td >= overlay_base_tile_count;
+}
+
+
+
+static SDL_Surface* load_charset_surface(const char* texture_name)
+{
+    auto it = charset_surfaces.find(texture_name);
+    if (it != charset_surfaces.end()) {
+        return it->second;
+    }
+
+    std::string full_path =
+        resource_path() + "images" + PATH_DELIMITER + texture_name + ".png";
+
+    SDL_Surface* surface = IMG_Load(full_path.c_str());
+    if (!surface) {
+        error(format(
+            "Failed to load charset %: %", full_path.c_str(), IMG_GetError()));
+        return nullptr;
+    }
+
+    // Set black as transparent
+    Uint32 color_key = SDL_MapRGB(surface->format, 0, 0, 16);
+    SDL_SetColorKey(surface, SDL_TRUE, color_key);
+
+    charset_surfaces[texture_name] = surface;
+
+    return surface;
+}
+
+
+
+// The overlay and tile atlases get patched at runtime (glyph mapping, encoded
+// tiles, overlay chunks). Rather than rebuilding the whole texture after each
+// patched tile, the atlases use streaming textures: patching a surface records
+// a dirty rect, and flush_atlas_uploads() copies the dirty regions into the
+// textures in one batch before the frame is drawn.
+struct AtlasUploads
+{
+    SDL_Texture** texture_;
+    SDL_Surface** surface_;
+    std::vector<SDL_Rect> dirty_;
+
+    // Upload the entire surface (too many dirty rects to bother tracking).
+    bool full_ = false;
+
+    // The surface changed size, the texture needs to be recreated.
+    bool resized_ = false;
+
+    // Bumped whenever the texture's contents change.
+    u32 version_ = 0;
+};
+
+static AtlasUploads overlay_uploads{&current_overlay_texture, &overlay_surface};
+static AtlasUploads tile0_uploads{&tile0_texture, &tile0_surface};
+static AtlasUploads tile1_uploads{&tile1_texture, &tile1_surface};
+
+static SDL_Surface* atlas_staging_surface = nullptr;
+
+
+
+static void
+atlas_upload(SDL_Texture* texture, SDL_Surface* surface, SDL_Rect rect)
+{
+    if (not atlas_staging_surface or atlas_staging_surface->w < rect.w or
+        atlas_staging_surface->h < rect.h) {
+
+        int w = rect.w;
+        int h = rect.h;
+        if (atlas_staging_surface) {
+            w = std::max(w, atlas_staging_surface->w);
+            h = std::max(h, atlas_staging_surface->h);
+            SDL_FreeSurface(atlas_staging_surface);
+        }
+
+        atlas_staging_surface = SDL_CreateRGBSurfaceWithFormat(
+            0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+
+        if (not atlas_staging_surface) {
+            error(format("Failed to create atlas staging surface: %",
+                         SDL_GetError()));
+            return;
+        }
+    }
+
+    SDL_Rect staging_rect{0, 0, rect.w, rect.h};
+    SDL_FillRect(atlas_staging_surface, &staging_rect, 0);
+
+    // NOTE: copy pixels verbatim, except for color keyed ones, which stay
+    // transparent. Same result as SDL_CreateTextureFromSurface().
+    SDL_BlendMode blend_mode;
+    SDL_GetSurfaceBlendMode(surface, &blend_mode);
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(surface, &rect, atlas_staging_surface, &staging_rect);
+    SDL_SetSurfaceBlendMode(surface, blend_mode);
+
+    if (SDL_UpdateTexture(texture,
+                          &rect,
+                          atlas_staging_surface->pixels,
+                          atlas_staging_surface->pitch) not_eq 0) {
+        error(format("Failed to update atlas texture: %", SDL_GetError()));
+    }
+}
+
+
+
+static SDL_Texture* create_atlas_texture(SDL_Surface* surface)
+{
+    SDL_Texture* texture = SDL_CreateTexture(renderer,
+                                             SDL_PIXELFORMAT_ARGB8888,
+                                             SDL_TEXTUREACCESS_STREAMING,
+                                             surface->w,
+                                             surface->h);
+    if (not texture) {
+        return nullptr;
+    }
+
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    atlas_upload(texture, surface, {0, 0, surface->w, surface->h});
+
+    return texture;
+}
+
+
+
+static void atlas_reset(AtlasUploads& atlas)
+{
+    atlas.dirty_.clear();
+    atlas.full_ = false;
+    atlas.resized_ = false;
+    ++atlas.version_;
+}
+
+
+
+static void atlas_mark_dirty(AtlasUploads& atlas, SDL_Rect rect)
+{
+    SDL_Surface* surface = *atlas.surface_;
+    if (not surface or atlas.full_ or atlas.resized_) {
+        return;
+    }
+
+    const SDL_Rect bounds{0, 0, surface->w, surface->h};
+    if (not SDL_IntersectRect(&rect, &bounds, &rect)) {
+        return;
+    }
+
+    for (auto& r : atlas.dirty_) {
+        if (SDL_RectEquals(&r, &rect)) {
+            return;
+        }
+    }
+
+    static const u32 max_dirty_rects = 256;
+
+    if (atlas.dirty_.size() == max_dirty_rects) {
+        atlas.dirty_.clear();
+        atlas.full_ = true;
+        return;
+    }
+
+    atlas.dirty_.push_back(rect);
+}
+
+
+
+// Tiles drawn with one of the special palettes render as silhouettes: the
+// tile's alpha mask filled with a solid color. Instead of rendering each such
+// tile through an intermediate target, keep a white silhouette copy of each
+// atlas, rebuilt only when the atlas changes, and tint it with a color mod.
+struct RecolorAtlas
+{
+    SDL_Texture* source_;
+    SDL_Texture* silhouette_;
+    u32 version_;
+};
+
+static std::vector<RecolorAtlas> recolor_atlases;
+
+
+
+static u32 atlas_version(SDL_Texture* texture)
+{
+    for (auto atlas : {&overlay_uploads, &tile0_uploads, &tile1_uploads}) {
+        if (*atlas->texture_ == texture) {
+            return atlas->version_;
+        }
+    }
+    return 0;
+}
+
+
+
+// Must be called before destroying a texture that may have a silhouette, as
+// a new texture could be allocated at the same address.
+static void recolor_atlas_forget(SDL_Texture* source)
+{
+    for (auto it = recolor_atlases.begin(); it not_eq recolor_atlases.end();
+         ++it) {
+        if (it->source_ == source) {
+            SDL_DestroyTexture(it->silhouette_);
+            recolor_atlases.erase(it);
+            return;
+        }
+    }
+}
+
+
+
+static void render_silhouette(SDL_Texture* source, SDL_Texture* target)
+{
+    SDL_Texture* prev_target = SDL_GetRenderTarget(renderer);
+    SDL_SetRenderTarget(renderer, target);
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
+    SDL_RenderClear(renderer);
+
+    Uint8 r, g, b, a;
+    SDL_BlendMode blend_mode;
+    SDL_GetTextureColorMod(source, &r, &g, &b);
+    SDL_GetTextureAlphaMod(source, &a);
+    SDL_GetTextureBlendMode(source, &blend_mode);
+
+    // Keep the white fill, take only the alpha channel from the source.
+    SDL_SetTextureColorMod(source, 0, 0, 0);
+    SDL_SetTextureAlphaMod(source, 255);
+    SDL_SetTextureBlendMode(
+        source,
+        SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ZERO,
+                                   SDL_BLENDFACTOR_ONE,
+                                   SDL_BLENDOPERATION_ADD,
+                                   SDL_BLENDFACTOR_ONE,
+                                   SDL_BLENDFACTOR_ZERO,
+                                   SDL_BLENDOPERATION_ADD));
+
+    SDL_RenderCopy(renderer, source, nullptr, nullptr);
+
+    SDL_SetTextureColorMod(source, r, g, b);
+    SDL_SetTextureAlphaMod(source, a);
+    SDL_SetTextureBlendMode(source, blend_mode);
+
+    SDL_SetRenderTarget(renderer, prev_target);
+}
+
+
+
+static SDL_Texture* recolor_atlas(SDL_Texture* source)
 {
-    std::vector<std::string> paths;
+    const auto version = atlas_version(source);
 
-    auto res_path = resource_path();
-    using recursive_directory_iterator =
-        std::filesystem::recursive_directory_iterator;
-    for (const auto& dirent : recursive_directory_iterator(res_path)) {
-        if (dirent.is_regular_file()) {
-            auto full_path = dirent.path().string();
-            if (full_path.size() and full_path[full_path.size() - 1] == '~') {
-                // Gah! It's an emacs temporary file...
-                continue;
-            }
-            // Remove resource_path() prefix to get relative path
-            if (full_path.size() > res_path.size() &&
-                full_path.substr(0, res_path.size()) == res_path) {
-                auto relative_path = full_path.substr(res_path.size());
-                // Remove leading path delimiter if present
-                if (!relative_path.empty() &&
-                    (relative_path[0] == '/' || relative_path[0] == '\\')) {
-                    relative_path = relative_path.substr(1);
-                }
-                relative_path = "/" + relative_path;
-                paths.push_back(relative_path);
-            }
+    RecolorAtlas* atlas = nullptr;
+    for (auto& a : recolor_atlases) {
+        if (a.source_ == source) {
+            atlas = &a;
+            break;
         }
     }
-    std::sort(paths.begin(), paths.end());
-    for (auto& path : paths) {
-        callback(path.c_str());
+
+    if (atlas and atlas->version_ == version) {
+        return atlas->silhouette_;
     }
-}
 
+    if (not atlas) {
+        int w, h;
+        SDL_QueryTexture(source, nullptr, nullptr, &w, &h);
 
+        auto silhouette = SDL_CreateTexture(
+            renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
 
-struct GlyphCacheEntry
-{
-    std::string texture_name;
-    u16 offset_in_texture;
-    TileDesc vram_tile_index;
-    bool in_use;
-};
+        if (not silhouette) {
+            error(format("Failed to create recolor atlas: %", SDL_GetError()));
+            return nullptr;
+        }
 
-static std::vector<GlyphCacheEntry> glyph_cache;
-static const int max_glyph_cache_size = 256;
+        SDL_SetTextureBlendMode(silhouette, SDL_BLENDMODE_BLEND);
 
+        recolor_atlases.push_back({source, silhouette, 0});
+        atlas = &recolor_atlases.back();
+    }
 
+    render_silhouette(source, atlas->silhouette_);
+    atlas->version_ = version;
 
-bool is_glyph(TileDesc td)
-{
-    return td >= overlay_base_tile_count;
+    return atlas->silhouette_;
 }
 
 
 
-static SDL_Surface* load_charset_surface(const char* texture_name)
+static void flush_atlas_uploads(AtlasUploads& atlas)
 {
-    auto it = charset_surfaces.find(texture_name);
-    if (it != charset_surfaces.end()) {
-        return it->second;
+    SDL_Surface* surface = *atlas.surface_;
+    SDL_Texture*& texture = *atlas.texture_;
+
+    if (not surface or not texture) {
+        atlas_reset(atlas);
+        return;
     }
 
-    std::string full_path =
-        resource_path() + "images" + PATH_DELIMITER + texture_name + ".png";
+    if (atlas.dirty_.empty() and not atlas.full_ and not atlas.resized_) {
+        return;
+    }
 
-    SDL_Surface* surface = IMG_Load(full_path.c_str());
-    if (!surface) {
-        error(format(
-            "Failed to load charset %: %", full_path.c_str(), IMG_GetError()));
-        return nullptr;
+    if (atlas.resized_) {
+        recolor_atlas_forget(texture);
+        SDL_DestroyTexture(texture);
+        texture = create_atlas_texture(surface);
+        if (not texture) {
+            error(format("Failed to recreate atlas texture: %",
+                         SDL_GetError()));
+        }
+    } else if (atlas.full_) {
+        atlas_upload(texture, surface, {0, 0, surface->w, surface->h});
+    } else {
+        for (auto& rect : atlas.dirty_) {
+            atlas_upload(texture, surface, rect);
+        }
     }
 
-    // Set black as transparent
-    Uint32 color_key = SDL_MapRGB(surface->format, 0, 0, 16);
-    SDL_SetColorKey(surface, SDL_TRUE, color_key);
+    atlas_reset(atlas);
+}
 
-    charset_surfaces[texture_name] = surface;
 
-    return surface;
+
+static void flush_atlas_uploads()
+{
+    flush_atlas_uploads(overlay_uploads);
+    flush_atlas_uploads(tile0_uploads);
+    flush_atlas_uploads(tile1_uploads);
 }
 
 
@@ -1779,14 +2923,9 @@ static void expand_overlay_surface()
     SDL_FreeSurface(overlay_surface);
     overlay_surface = new_surface;
 
-    // Recreate texture from expanded surface
-    if (current_overlay_texture) {
-        SDL_DestroyTexture(current_overlay_texture);
-    }
-
-    current_overlay_texture =
-        SDL_CreateTextureFromSurface(renderer, overlay_surface);
-    SDL_SetTextureBlendMode(current_overlay_texture, SDL_BLENDMODE_BLEND);
+    // The texture gets recreated at the expanded size on the next flush.
+    atlas_reset(overlay_uploads);
+    overlay_uploads.resized_ = true;
 
     overlay_texture_width = overlay_surface->w;
     overlay_texture_height = overlay_surface->h;
@@ -1805,32 +2944,27 @@ TileDesc Platform::map_glyph(const utf8::Codepoint& glyph,
         return 495; // bad_glyph equivalent
     }
 
-    // Check if this glyph is already mapped
-    for (auto& entry : glyph_cache) {
-        if (entry.in_use && entry.texture_name == mapping_info.texture_name_ &&
-            entry.offset_in_texture == mapping_info.offset_) {
+    const auto key =
+        glyph_cache_key(mapping_info.texture_name_, mapping_info.offset_);
+
+    auto found = glyph_cache_index.find(key);
+    if (found not_eq glyph_cache_index.end()) {
+        const int slot = found->second;
+        auto& entry = glyph_cache[slot];
+        if (entry.offset_in_texture == mapping_info.offset_ and
+            entry.texture_name == mapping_info.texture_name_) {
+            ++glyph_cache_stats.hits_;
+            glyph_lru_unlink(slot);
+            glyph_lru_push_front(slot);
             return entry.vram_tile_index;
         }
-    }
 
-    int slot_index = -1;
-    for (size_t i = 0; i < glyph_cache.size(); ++i) {
-        if (!glyph_cache[i].in_use) {
-            slot_index = i;
-            break;
-        }
+        // Two texture names with colliding hashes. Drop the older glyph.
+        glyph_cache_drop(slot);
+        glyph_cache_free_slots.push_back(slot);
     }
 
-    if (slot_index == -1) {
-        if (glyph_cache.size() >= max_glyph_cache_size) {
-            // Cache full - could implement LRU eviction here
-            warning("Glyph cache full!");
-            return 495; // bad_glyph
-        }
-
-        slot_index = glyph_cache.size();
-        glyph_cache.push_back(GlyphCacheEntry{});
-    }
+    ++glyph_cache_stats.misses_;
 
     // Load the charset texture
     SDL_Surface* charset = load_charset_surface(mapping_info.texture_name_);
@@ -1838,6 +2972,12 @@ TileDesc Platform::map_glyph(const utf8::Codepoint& glyph,
         return 495; // bad_glyph
     }
 
+    const int slot_index = glyph_cache_acquire_slot();
+    if (slot_index == -1) {
+        warning("Glyph cache full!");
+        return 495; // bad_glyph
+    }
+
     // Calculate the tile index in the expanded overlay texture
     // We append new glyphs after the base overlay tiles
     TileDesc new_tile_index = overlay_base_tile_count + slot_index;
@@ -1871,17 +3011,17 @@ TileDesc Platform::map_glyph(const utf8::Codepoint& glyph,
                          src_tile_x,
                          src_tile_y);
 
-    // Recreate the texture from the modified surface
-    if (current_overlay_texture) {
-        SDL_DestroyTexture(current_overlay_texture);
-    }
-    current_overlay_texture =
-        SDL_CreateTextureFromSurface(renderer, overlay_surface);
-    SDL_SetTextureBlendMode(current_overlay_texture, SDL_BLENDMODE_BLEND);
+    atlas_mark_dirty(overlay_uploads, {dst_tile_x * 8, dst_tile_y * 8, 8, 8});
 
     // Update cache entry
-    glyph_cache[slot_index] = {
-        mapping_info.texture_name_, mapping_info.offset_, new_tile_index, true};
+    glyph_cache[slot_index] = {mapping_info.texture_name_,
+                               mapping_info.offset_,
+                               new_tile_index,
+                               true,
+                               -1,
+                               -1};
+    glyph_cache_index[key] = slot_index;
+    glyph_lru_push_front(slot_index);
 
     return new_tile_index;
 }
@@ -1892,9 +3032,10 @@ void Platform::set_tile(u16 x, u16 y, TileDesc glyph, const FontColors& colors)
 {
     set_tile(Layer::overlay, x, y, glyph);
 
-    auto& val = tile_layers_[Layer::overlay][{x, y}];
-    val.text_fg_color_ = colors.foreground_;
-    val.text_bg_color_ = colors.background_;
+    if (auto tile = tile_layer(Layer::overlay).find(x % 32, y % 32)) {
+        tile->text_fg_color_ = colors.foreground_;
+        tile->text_bg_color_ = colors.background_;
+    }
 }
 
 
@@ -1904,9 +3045,7 @@ void Platform::enable_glyph_mode(bool enabled)
     set_gflag(GlobalFlag::glyph_mode, enabled);
 
     if (enabled) {
-        for (auto& entry : glyph_cache) {
-            entry.in_use = false;
-        }
+        glyph_cache_clear();
     }
 }
 
@@ -1915,14 +3054,12 @@ void Platform::enable_glyph_mode(bool enabled)
 void Platform::fill_overlay(u16 tile_desc)
 {
     // When filling overlay, mark all dynamic glyphs as unused
-    for (auto& entry : glyph_cache) {
-        entry.in_use = false;
-    }
+    glyph_cache_clear();
 
     // Fill all 32x32 overlay tiles with the specified tile
     for (u16 y = 0; y < 32; ++y) {
         for (u16 x = 0; x < 32; ++x) {
-            tile_layers_[Layer::overlay][{x, y}] = {tile_desc, 0};
+            tile_layer(Layer::overlay).assign(x, y, {tile_desc, 0});
         }
     }
 }
@@ -2044,16 +3181,9 @@ void Platform::overwrite_t0_tile(u16 index, const EncodedTile& t)
         SDL_UnlockSurface(tile0_surface);
     }
 
-    // Recreate the texture from the modified surface
-    if (tile0_texture) {
-        SDL_DestroyTexture(tile0_texture);
-    }
-    tile0_texture = SDL_CreateTextureFromSurface(renderer, tile0_surface);
-    if (!tile0_texture) {
-        error(format("Failed to recreate tile0 texture: %", SDL_GetError()));
-        return;
-    }
-    SDL_SetTextureBlendMode(tile0_texture, SDL_BLENDMODE_BLEND);
+    atlas_mark_dirty(
+        tile0_uploads,
+        {tile_x * tile_size, tile_y * tile_size, tile_size, tile_size});
 }
 
 
@@ -2151,16 +3281,9 @@ void Platform::overwrite_t1_tile(u16 index, const EncodedTile& t)
         SDL_UnlockSurface(tile1_surface);
     }
 
-    // Recreate the texture from the modified surface
-    if (tile1_texture) {
-        SDL_DestroyTexture(tile1_texture);
-    }
-    tile1_texture = SDL_CreateTextureFromSurface(renderer, tile1_surface);
-    if (!tile1_texture) {
-        error(format("Failed to recreate tile1 texture: %", SDL_GetError()));
-        return;
-    }
-    SDL_SetTextureBlendMode(tile1_texture, SDL_BLENDMODE_BLEND);
+    atlas_mark_dirty(
+        tile1_uploads,
+        {tile_x * tile_size, tile_y * tile_size, tile_size, tile_size});
 }
 
 
@@ -2256,17 +3379,9 @@ void Platform::overwrite_overlay_tile(u16 index, const EncodedTile& t)
         SDL_UnlockSurface(overlay_surface);
     }
 
-    // Recreate the texture from the modified surface
-    if (current_overlay_texture) {
-        SDL_DestroyTexture(current_overlay_texture);
-    }
-    current_overlay_texture =
-        SDL_CreateTextureFromSurface(renderer, overlay_surface);
-    if (!current_overlay_texture) {
-        error(format("Failed to recreate overlay texture: %", SDL_GetError()));
-        return;
-    }
-    SDL_SetTextureBlendMode(current_overlay_texture, SDL_BLENDMODE_BLEND);
+    atlas_mark_dirty(
+        overlay_uploads,
+        {tile_x * tile_size, tile_y * tile_size, tile_size, tile_size});
 }
 
 
@@ -2680,6 +3795,7 @@ void load_metatiled_chunk(SDL_Surface* source_surface,
                 Uint32 transparent =
                     SDL_MapRGBA(overlay_surface->format, 255, 0, 255, 0);
                 SDL_FillRect(overlay_surface, &dst_rect, transparent);
+                atlas_mark_dirty(overlay_uploads, dst_rect);
 
                 if (SDL_BlitSurface(source_surface,
                                     &src_rect,
@@ -2832,6 +3948,7 @@ void Platform::load_overlay_chunk(TileDesc dst,
             Uint32 transparent =
                 SDL_MapRGBA(overlay_surface->format, 255, 0, 255, 0);
             SDL_FillRect(overlay_surface, &dst_rect, transparent);
+            atlas_mark_dirty(overlay_uploads, dst_rect);
 
             // Blit the tile
             if (SDL_BlitSurface(
@@ -2843,22 +3960,6 @@ void Platform::load_overlay_chunk(TileDesc dst,
             }
         }
     }
-
-
-    // Recreate the texture from the modified surface
-    if (current_overlay_texture) {
-        SDL_DestroyTexture(current_overlay_texture);
-    }
-
-    current_overlay_texture =
-        SDL_CreateTextureFromSurface(renderer, overlay_surface);
-    if (!current_overlay_texture) {
-        error(format("load_overlay_chunk: Failed to recreate texture: %",
-                     SDL_GetError()));
-        return;
-    }
-
-    SDL_SetTextureBlendMode(current_overlay_texture, SDL_BLENDMODE_BLEND);
 }
 
 
@@ -3069,6 +4170,10 @@ SDL_Surface* expand_surface_to_width(SDL_Surface* loaded_surface, int width)
 
 void Platform::load_tile0_texture(const char* name_or_path)
 {
+    if (forward_to_render_thread([&] { load_tile0_texture(name_or_path); })) {
+        return;
+    }
+
     if (not renderer) {
         return;
     }
@@ -3076,6 +4181,7 @@ void Platform::load_tile0_texture(const char* name_or_path)
     auto name = extract_texture_name(name_or_path);
 
     if (tile0_texture) {
+        recolor_atlas_forget(tile0_texture);
         SDL_DestroyTexture(tile0_texture);
         tile0_texture = nullptr;
     }
@@ -3106,7 +4212,9 @@ void Platform::load_tile0_texture(const char* name_or_path)
     // Keep the surface for later modification
     tile0_surface = loaded_surface;
 
-    tile0_texture = SDL_CreateTextureFromSurface(renderer, tile0_surface);
+    atlas_reset(tile0_uploads);
+
+    tile0_texture = create_atlas_texture(tile0_surface);
     if (!tile0_texture) {
         error(format("Failed to create tile0 texture from %: %",
                      full_path.c_str(),
@@ -3116,8 +4224,6 @@ void Platform::load_tile0_texture(const char* name_or_path)
         return;
     }
 
-    SDL_SetTextureBlendMode(tile0_texture, SDL_BLENDMODE_BLEND);
-
     tile0_texture_width = tile0_surface->w;
     tile0_texture_height = tile0_surface->h;
 }
@@ -3126,12 +4232,17 @@ void Platform::load_tile0_texture(const char* name_or_path)
 
 void Platform::load_tile1_texture(const char* name_or_path)
 {
+    if (forward_to_render_thread([&] { load_tile1_texture(name_or_path); })) {
+        return;
+    }
+
     if (not renderer) {
         return;
     }
     auto name = extract_texture_name(name_or_path);
 
     if (tile1_texture) {
+        recolor_atlas_forget(tile1_texture);
         SDL_DestroyTexture(tile1_texture);
         tile1_texture = nullptr;
     }
@@ -3159,7 +4270,9 @@ void Platform::load_tile1_texture(const char* name_or_path)
     // Keep the surface for later modification
     tile1_surface = loaded_surface;
 
-    tile1_texture = SDL_CreateTextureFromSurface(renderer, tile1_surface);
+    atlas_reset(tile1_uploads);
+
+    tile1_texture = create_atlas_texture(tile1_surface);
     if (!tile1_texture) {
         error(format("Failed to create tile1 texture from %: %",
                      full_path.c_str(),
@@ -3169,8 +4282,6 @@ void Platform::load_tile1_texture(const char* name_or_path)
         return;
     }
 
-    SDL_SetTextureBlendMode(tile1_texture, SDL_BLENDMODE_BLEND);
-
     tile1_texture_width = tile1_surface->w;
     tile1_texture_height = tile1_surface->h;
 }
@@ -3230,6 +4341,10 @@ static int sprite_texture_height = 0;
 
 void Platform::load_sprite_texture(const char* name)
 {
+    if (forward_to_render_thread([&] { load_sprite_texture(name); })) {
+        return;
+    }
+
     if (not renderer) {
         return;
     }
@@ -3350,14 +4465,19 @@ static Optional<Platform::UnrecoverrableErrorCallback>
 
 void Platform::fatal(const char* msg)
 {
+    // NOTE: With --pipeline, a fatal error raised during an update shows the
+    // error screen from the main thread.
+    forward_to_render_thread([msg] { fatal(msg); });
+
     error(msg);
 
     if (::__platform__ and ::unrecoverrable_error_callback) {
         (*::unrecoverrable_error_callback)(&*msg);
     }
 
-    if (extensions.has_startup_opt("--regression")) {
-        exit(EXIT_FAILURE);
+    if (extensions.has_startup_opt("--regression") or
+        extensions.has_startup_opt("--bench")) {
+        exit_game(EXIT_FAILURE);
     }
 
     PLATFORM.speaker().stop_music();
@@ -3410,7 +4530,7 @@ void Platform::fatal(const char* msg)
         }
     }
 
-    exit(EXIT_FAILURE);
+    exit_game(EXIT_FAILURE);
 }
 
 
@@ -3484,6 +4604,10 @@ std::string current_background_texture;
 
 void Platform::load_background_texture(const char* name)
 {
+    if (forward_to_render_thread([&] { load_background_texture(name); })) {
+        return;
+    }
+
     if (not renderer) {
         return;
     }
@@ -3492,6 +4616,7 @@ void Platform::load_background_texture(const char* name)
     auto texture_name = extract_texture_name(name);
 
     if (background_texture) {
+        recolor_atlas_forget(background_texture);
         SDL_DestroyTexture(background_texture);
         background_texture = nullptr;
     }
@@ -3533,6 +4658,12 @@ void Platform::load_background_texture(const char* name)
 
 bool Platform::load_overlay_texture(const char* name)
 {
+    bool result = false;
+    if (forward_to_render_thread(
+            [&] { result = load_overlay_texture(name); })) {
+        return result;
+    }
+
     if (not renderer) {
         return true;
     }
@@ -3542,6 +4673,7 @@ bool Platform::load_overlay_texture(const char* name)
     }
     // Clean up old texture/surface if they exist
     if (current_overlay_texture) {
+        recolor_atlas_forget(current_overlay_texture);
         SDL_DestroyTexture(current_overlay_texture);
         current_overlay_texture = nullptr;
     }
@@ -3551,9 +4683,7 @@ bool Platform::load_overlay_texture(const char* name)
     }
 
     // Clear glyph cache
-    for (auto& entry : glyph_cache) {
-        entry.in_use = false;
-    }
+    glyph_cache_clear();
 
     std::string full_path =
         resource_path() + "images" + PATH_DELIMITER + name + ".png";
@@ -3633,8 +4763,9 @@ bool Platform::load_overlay_texture(const char* name)
     overlay_index_zero_is_transparent =
         is_tile_transparent(overlay_surface, 0, 0, 8);
 
-    current_overlay_texture =
-        SDL_CreateTextureFromSurface(renderer, overlay_surface);
+    atlas_reset(overlay_uploads);
+
+    current_overlay_texture = create_atlas_texture(overlay_surface);
     if (!current_overlay_texture) {
         error(format("Failed to create overlay texture from %: %",
                      full_path.c_str(),
@@ -3644,8 +4775,6 @@ bool Platform::load_overlay_texture(const char* name)
         return false;
     }
 
-    SDL_SetTextureBlendMode(current_overlay_texture, SDL_BLENDMODE_BLEND);
-
     overlay_texture_width = max_width; // Always report max_width
     overlay_texture_height = source_height;
 
@@ -3671,6 +4800,10 @@ Optional<std::chrono::microseconds> sleep_time;
 
 void Platform::sleep(u32 frames)
 {
+    if (extensions.has_startup_opt("--bench")) {
+        return;
+    }
+
     const auto amount =
         frames * (std::chrono::duration_cast<std::chrono::microseconds>(
                       std::chrono::seconds(1)) /
@@ -3728,7 +4861,8 @@ Microseconds Platform::DeltaClock::last_delta() const
 Microseconds Platform::DeltaClock::reset()
 {
     if (extensions.has_startup_opt("--validate-scripts") or
-        extensions.has_startup_opt("--regression")) {
+        extensions.has_startup_opt("--regression") or
+        extensions.has_startup_opt("--bench")) {
         return 16777;
     }
 
@@ -4262,7 +5396,17 @@ struct SpriteDrawInfo
 
 
 
-static std::vector<SpriteDrawInfo> sprite_draw_list;
+static std::vector<SpriteDrawInfo> sprite_draw_list[4];
+
+
+
+static void clear_draw_queues()
+{
+    for (int prio = 0; prio < 4; ++prio) {
+        rect_draw_queue[prio].clear();
+        sprite_draw_list[prio].clear();
+    }
+}
 
 
 
@@ -4399,24 +5543,36 @@ void Platform::Screen::draw(const Sprite& spr)
         scale_y = 256.0 / pd;
     }
 
-    sprite_draw_list.push_back({pos,
-                                spr.get_size(),
-                                spr.get_mix().color_,
-                                true,
-                                spr.get_texture_index(),
-                                spr.get_flip(),
-                                sprite_rotation_to_degrees(-spr.get_rotation()),
-                                spr.get_priority(),
-                                spr.get_alpha(),
-                                spr.get_mix().amount_,
-                                {scale_x, scale_y}});
+    if (spr.get_priority() >= 4) {
+        return;
+    }
+
+    sprite_draw_list[spr.get_priority()].push_back(
+        {pos,
+         spr.get_size(),
+         spr.get_mix().color_,
+         true,
+         spr.get_texture_index(),
+         spr.get_flip(),
+         sprite_rotation_to_degrees(-spr.get_rotation()),
+         spr.get_priority(),
+         spr.get_alpha(),
+         spr.get_mix().amount_,
+         {scale_x, scale_y}});
 }
 
 
 
 void Platform::Screen::clear()
 {
-    if (extensions.has_startup_opt("--no-window-system")) {
+    if (forward_to_render_thread([this] { clear(); })) {
+        return;
+    }
+
+    pipeline_flush_present();
+
+    if (extensions.has_startup_opt("--no-window-system") and
+        not extensions.has_startup_opt("--bench")) {
         // In windowless mode, without vsync, the game will needlessly burn cpu utilization.
         std::this_thread::sleep_for(std::chrono::milliseconds(17));
     }
@@ -4425,8 +5581,7 @@ void Platform::Screen::clear()
         return;
     }
 
-    rect_draw_queue.clear();
-    sprite_draw_list.clear();
+    clear_draw_queues();
     point_lights.clear();
 
     if (extensions.has_startup_opt("--validate-scripts") or
@@ -4541,17 +5696,119 @@ void display_fade()
 
 
 
-void draw_rect_group(int prio)
+// Quads are submitted through SDL_RenderGeometry, and consecutive quads that
+// share a texture go out in a single call. Tints and alpha travel as vertex
+// colors, so they don't break up a batch the way texture color/alpha mods
+// would.
+struct QuadBatch
 {
-    if (not renderer) {
+    SDL_Texture* texture_ = nullptr;
+    float texture_w_ = 1;
+    float texture_h_ = 1;
+    std::vector<SDL_Vertex> vertices_;
+    std::vector<int> indices_;
+};
+
+static QuadBatch quad_batch;
+
+
+
+static void quad_batch_flush()
+{
+    if (quad_batch.vertices_.empty()) {
         return;
     }
 
-    for (auto& rect_info : reversed(rect_draw_queue)) {
-        if (rect_info.priority not_eq prio) {
-            continue;
+    SDL_RenderGeometry(renderer,
+                       quad_batch.texture_,
+                       quad_batch.vertices_.data(),
+                       quad_batch.vertices_.size(),
+                       quad_batch.indices_.data(),
+                       quad_batch.indices_.size());
+
+    quad_batch.vertices_.clear();
+    quad_batch.indices_.clear();
+}
+
+
+
+// Appends a quad covering dst, rotated by the given angle (degrees clockwise)
+// around its center, like SDL_RenderCopyEx(). src is ignored for untextured
+// quads.
+static void quad_batch_push(SDL_Texture* texture,
+                            const SDL_Rect& src,
+                            const SDL_Rect& dst,
+                            double rotation,
+                            Vec2<bool> flip,
+                            SDL_Color color)
+{
+    if (texture not_eq quad_batch.texture_) {
+        quad_batch_flush();
+        quad_batch.texture_ = texture;
+        if (texture) {
+            int w, h;
+            SDL_QueryTexture(texture, nullptr, nullptr, &w, &h);
+            quad_batch.texture_w_ = w;
+            quad_batch.texture_h_ = h;
         }
+    }
+
+    float u0 = src.x / quad_batch.texture_w_;
+    float u1 = (src.x + src.w) / quad_batch.texture_w_;
+    float v0 = src.y / quad_batch.texture_h_;
+    float v1 = (src.y + src.h) / quad_batch.texture_h_;
+
+    if (flip.x) {
+        std::swap(u0, u1);
+    }
+    if (flip.y) {
+        std::swap(v0, v1);
+    }
+
+    const float half_w = dst.w * 0.5f;
+    const float half_h = dst.h * 0.5f;
+    const float cx = dst.x + half_w;
+    const float cy = dst.y + half_h;
+
+    const SDL_FPoint corners[4] = {{-half_w, -half_h},
+                                   {half_w, -half_h},
+                                   {half_w, half_h},
+                                   {-half_w, half_h}};
+    const SDL_FPoint tex_coords[4] = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+
+    float c = 1;
+    float s = 0;
+    if (rotation not_eq 0) {
+        const float radians = (float)(rotation * M_PI / 180.0);
+        c = SDL_cosf(radians);
+        s = SDL_sinf(radians);
+    }
+
+    const int base = quad_batch.vertices_.size();
+
+    for (int i = 0; i < 4; ++i) {
+        SDL_Vertex v;
+        v.position.x = cx + corners[i].x * c - corners[i].y * s;
+        v.position.y = cy + corners[i].x * s + corners[i].y * c;
+        v.color = color;
+        v.tex_coord = tex_coords[i];
+        quad_batch.vertices_.push_back(v);
+    }
+
+    for (int i : {0, 1, 2, 0, 2, 3}) {
+        quad_batch.indices_.push_back(base + i);
+    }
+}
+
+
+
+void draw_rect_group(int prio)
+{
+    if (not renderer) {
+        return;
+    }
 
+    for (auto& rect_info : reversed(rect_draw_queue[prio])) {
         SDL_Rect rect;
         rect.x = rect_info.x;
         rect.y = rect_info.y;
@@ -4559,9 +5816,10 @@ void draw_rect_group(int prio)
         rect.h = rect_info.h;
 
         auto color = color_to_sdl(rect_info.tint);
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-        SDL_RenderFillRect(renderer, &rect);
+        quad_batch_push(nullptr, rect, rect, 0, {false, false}, color);
     }
+
+    quad_batch_flush();
 }
 
 
@@ -4573,10 +5831,7 @@ void draw_sprite_group(int prio)
     }
 
     // Draw all sprites as colored rectangles or textured
-    for (const auto& sprite : reversed(sprite_draw_list)) {
-        if (sprite.priority not_eq prio) {
-            continue;
-        }
+    for (const auto& sprite : reversed(sprite_draw_list[prio])) {
         if (!sprite.visible)
             continue;
 
@@ -4625,17 +5880,6 @@ void draw_sprite_group(int prio)
             dst.x = sprite.position.x - (dst.w - src.w) / 2;
             dst.y = sprite.position.y - (dst.h - src.h) / 2;
 
-            // Handle flipping
-            SDL_RendererFlip flip = SDL_FLIP_NONE;
-            if (sprite.flip.x && sprite.flip.y) {
-                flip =
-                    (SDL_RendererFlip)(SDL_FLIP_HORIZONTAL | SDL_FLIP_VERTICAL);
-            } else if (sprite.flip.x) {
-                flip = SDL_FLIP_HORIZONTAL;
-            } else if (sprite.flip.y) {
-                flip = SDL_FLIP_VERTICAL;
-            }
-
             // Calculate base alpha
             u8 base_alpha =
                 (sprite.alpha == Sprite::Alpha::translucent) ? 127 : 255;
@@ -4645,50 +5889,36 @@ void draw_sprite_group(int prio)
                 // Dual-pass rendering with scaling
                 float mix_ratio = sprite.mix_amount / 255.0f;
 
-                SDL_SetTextureColorMod(current_sprite_texture, 255, 255, 255);
-                SDL_SetTextureAlphaMod(current_sprite_texture,
-                                       base_alpha * (1.0f - mix_ratio));
-                SDL_RenderCopyEx(renderer,
-                                 current_sprite_texture,
-                                 &src,
-                                 &dst,
-                                 sprite.rotation,
-                                 nullptr,
-                                 flip);
+                quad_batch_push(current_sprite_texture,
+                                src,
+                                dst,
+                                sprite.rotation,
+                                sprite.flip,
+                                {255,
+                                 255,
+                                 255,
+                                 (u8)(base_alpha * (1.0f - mix_ratio))});
 
                 auto mix_color = color_to_sdl(sprite.color);
-                SDL_SetTextureColorMod(
-                    sprite_mask_texture, mix_color.r, mix_color.g, mix_color.b);
-                SDL_SetTextureAlphaMod(sprite_mask_texture,
-                                       base_alpha * mix_ratio);
-                SDL_RenderCopyEx(renderer,
-                                 sprite_mask_texture,
-                                 &src,
-                                 &dst,
-                                 sprite.rotation,
-                                 nullptr,
-                                 flip);
-
-                SDL_SetTextureColorMod(sprite_mask_texture, 255, 255, 255);
-                SDL_SetTextureAlphaMod(sprite_mask_texture, 255);
-                SDL_SetTextureColorMod(current_sprite_texture, 255, 255, 255);
-                SDL_SetTextureAlphaMod(current_sprite_texture, 255);
+                mix_color.a = base_alpha * mix_ratio;
+                quad_batch_push(sprite_mask_texture,
+                                src,
+                                dst,
+                                sprite.rotation,
+                                sprite.flip,
+                                mix_color);
             } else {
-                SDL_SetTextureColorMod(current_sprite_texture, 255, 255, 255);
-                SDL_SetTextureAlphaMod(current_sprite_texture, base_alpha);
-
-                SDL_RenderCopyEx(renderer,
-                                 current_sprite_texture,
-                                 &src,
-                                 &dst,
-                                 sprite.rotation,
-                                 nullptr,
-                                 flip);
-
-                SDL_SetTextureAlphaMod(current_sprite_texture, 255);
+                quad_batch_push(current_sprite_texture,
+                                src,
+                                dst,
+                                sprite.rotation,
+                                sprite.flip,
+                                {255, 255, 255, base_alpha});
             }
         }
     }
+
+    quad_batch_flush();
 }
 
 
@@ -4709,7 +5939,7 @@ static void draw_parallax_background(
         return;
     }
 
-    auto& tiles = tile_layers_[Layer::background];
+    auto& tiles = tile_layer(Layer::background);
     if (tiles.empty()) {
         return;
     }
@@ -4718,16 +5948,13 @@ static void draw_parallax_background(
         const int tile_size = 8;
         const int wrap_width = 256; // 32 tiles * 8 pixels
 
-        for (auto& [pos, tile_info] : tiles) {
+        tiles.for_each([&](s32 tile_x, s32 tile_y, TileInfo& tile_info) {
             if (tile_info.tile_desc == 0)
-                continue;
-
-            s32 tile_x = (s32)pos.first;
-            s32 tile_y = (s32)pos.second;
+                return;
 
             // Skip tiles not in this strip's row range
             if (tile_y < strip.start_tile_row || tile_y > strip.end_tile_row) {
-                continue;
+                return;
             }
 
             SDL_Rect src =
@@ -4761,7 +5988,7 @@ static void draw_parallax_background(
                     SDL_RenderCopy(renderer, texture, &src, &dst);
                 }
             }
-        }
+        });
     };
 
     // Gap filler strip (rows 20-21) - positioned flush with end of strip2
@@ -4805,7 +6032,7 @@ static void draw_tile_layer(Layer layer,
         return;
     }
 
-    auto& tiles = tile_layers_[layer];
+    auto& tiles = tile_layer(layer);
     if (tiles.empty()) {
         return;
     }
@@ -4836,12 +6063,18 @@ static void draw_tile_layer(Layer layer,
     bool is_ext_layer =
         (layer == Layer::map_0_ext || layer == Layer::map_1_ext);
 
-    for (auto& [pos, tile_info] : tiles) {
-        if (skip_tile_zero and tile_info.tile_desc == 0)
-            continue;
+    struct RecoloredTile
+    {
+        u16 palette_;
+        SDL_Rect src_;
+        SDL_Rect dst_;
+    };
 
-        s32 tile_x = (s32)pos.first;
-        s32 tile_y = (s32)pos.second;
+    static std::vector<RecoloredTile> recolored_tiles;
+
+    tiles.for_each([&](s32 tile_x, s32 tile_y, TileInfo& tile_info) {
+        if (skip_tile_zero and tile_info.tile_desc == 0)
+            return;
 
         SDL_Rect src;
         SDL_Rect dst;
@@ -4861,61 +6094,35 @@ static void draw_tile_layer(Layer layer,
             dst.h = 8;
         }
 
-        // Check if this tile uses a special palette (13, 14, or 15)
-        auto special_it = special_palettes.find(tile_info.palette);
-        if (special_it != special_palettes.end()) {
-            // Render to intermediate buffer
-            SDL_SetRenderTarget(renderer, tile_recolor_buffer);
-
-            // Fill buffer with the solid color
-            SDL_SetRenderDrawColor(renderer,
-                                   special_it->second.r,
-                                   special_it->second.g,
-                                   special_it->second.b,
-                                   0); // Alpha 0 for now
-            SDL_RenderClear(renderer);
-
-            // Copy ONLY the alpha channel from the tile
-            // Draw the tile but use a custom blend mode that only copies alpha
-            SDL_Rect temp_dst = {0, 0, dst.w, dst.h};
-
-            // Set color mod to black so RGB doesn't affect anything
-            SDL_SetTextureColorMod(texture, 0, 0, 0);
-            SDL_SetTextureAlphaMod(texture, 255);
-
-            // Use a blend mode that copies the source alpha to destination alpha
-            SDL_SetTextureBlendMode(
-                texture,
-                SDL_ComposeCustomBlendMode(
-                    SDL_BLENDFACTOR_ZERO, // srcColorFactor (ignore source RGB)
-                    SDL_BLENDFACTOR_ONE, // dstColorFactor (keep our solid color)
-                    SDL_BLENDOPERATION_ADD, // colorOperation
-                    SDL_BLENDFACTOR_ONE,    // srcAlphaFactor (use source alpha)
-                    SDL_BLENDFACTOR_ZERO, // dstAlphaFactor (replace dest alpha)
-                    SDL_BLENDOPERATION_ADD // alphaOperation
-                    ));
-
-            SDL_RenderCopy(renderer, texture, &src, &temp_dst);
-
-            // Reset texture settings
-            SDL_SetTextureColorMod(texture, 255, 255, 255);
-            SDL_SetTextureAlphaMod(texture, apply_translucence ? 127 : 255);
-            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
-
-            // Switch back to main screen
-            SDL_SetRenderTarget(renderer, nullptr);
+        // Tiles with a special palette (13, 14, or 15) are drawn afterwards,
+        // from the silhouette atlas.
+        if (special_palettes.count(tile_info.palette)) {
+            recolored_tiles.push_back({tile_info.palette, src, dst});
+            return;
+        }
 
-            // Draw the recolored tile to screen
-            SDL_RenderCopy(renderer, tile_recolor_buffer, &temp_dst, &dst);
+        if (tile_info.palette == 9) {
+            SDL_SetTextureColorMod(texture, 127, 127, 127);
+            SDL_RenderCopy(renderer, texture, &src, &dst);
+            SDL_SetTextureColorMod(texture, 255, 255, 255);
         } else {
-            if (tile_info.palette == 9) {
-                SDL_SetTextureColorMod(texture, 127, 127, 127);
-                SDL_RenderCopy(renderer, texture, &src, &dst);
-                SDL_SetTextureColorMod(texture, 255, 255, 255);
-            } else {
-                SDL_RenderCopy(renderer, texture, &src, &dst);
+            SDL_RenderCopy(renderer, texture, &src, &dst);
+        }
+    });
+
+    if (not recolored_tiles.empty()) {
+        if (auto silhouette = recolor_atlas(texture)) {
+            for (auto& [palette, color] : special_palettes) {
+                SDL_SetTextureColorMod(silhouette, color.r, color.g, color.b);
+                for (auto& tile : recolored_tiles) {
+                    if (tile.palette_ == palette) {
+                        SDL_RenderCopy(
+                            renderer, silhouette, &tile.src_, &tile.dst_);
+                    }
+                }
             }
         }
+        recolored_tiles.clear();
     }
 
     // Reset alpha after drawing
@@ -4958,16 +6165,16 @@ void draw_overlay_layer(int y_offset)
         return;
     }
 
-    auto& overlay_tiles = tile_layers_[Layer::overlay];
-    for (auto& [pos, tile_info] : overlay_tiles) {
+    auto& overlay_tiles = tile_layer(Layer::overlay);
+    overlay_tiles.for_each([&](int x, int y, TileInfo& tile_info) {
         auto tile_desc = tile_info.tile_desc;
         if (tile_desc == 0)
-            continue;
+            return;
 
         SDL_Rect src = get_overlay_tile_source_rect(tile_desc);
         SDL_Rect dst;
-        dst.x = pos.first * 8 - overlay_origin.x;
-        dst.y = pos.second * 8 - (overlay_origin.y + y_offset);
+        dst.x = x * 8 - overlay_origin.x;
+        dst.y = y * 8 - (overlay_origin.y + y_offset);
         dst.w = 8;
         dst.h = 8;
 
@@ -5009,22 +6216,36 @@ void draw_overlay_layer(int y_offset)
 
         // Reset color mod
         SDL_SetTextureColorMod(current_overlay_texture, 255, 255, 255);
-    }
+    });
 }
 
 
 
 void Platform::Screen::display()
 {
+    if (forward_to_render_thread([this] { display(); })) {
+        return;
+    }
+
+    PROFILE_ZONE("Screen::display");
+
+    if (not pipeline.servicing_) {
+        frame_stats_sample();
+    }
+
     if (not renderer) {
         return;
     }
 
+    pipeline_flush_present();
+
     if (extensions.has_startup_opt("--validate-scripts") or
         extensions.has_startup_opt("--regression")) {
         return;
     }
 
+    flush_atlas_uploads();
+
     if (background_texture) {
         if (parallax_clouds_enabled) {
             draw_parallax_background(background_texture,
@@ -5149,9 +6370,15 @@ void Platform::Screen::display()
         display_fade();
     }
 
-    SDL_RenderPresent(renderer);
-    sprite_draw_list.clear();
-    rect_draw_queue.clear();
+    if (pipeline_enabled and not pipeline.servicing_) {
+        // Presented by update_during_present(), in parallel with the next
+        // frame's update.
+        pipeline.present_pending_ = true;
+    } else {
+        SDL_RenderPresent(renderer);
+    }
+
+    clear_draw_queues();
 }
 
 
@@ -5977,10 +7204,21 @@ Platform::Platform()
 
     initialize_audio();
 
-    std::ifstream in(get_save_file_path(),
-                     std::ios_base::in | std::ios_base::binary);
-    if (in) {
-        in.read((char*)save_buffer, ::save_capacity);
+#ifndef _WIN32
+    if (extensions.has_startup_opt("--mmap-save")) {
+        if (not save_file_map()) {
+            error("failed to map save file, falling back to buffered io");
+        }
+    }
+#endif
+
+    if (not save_mmapped) {
+        std::ifstream in(get_save_file_path(),
+                         std::ios_base::in | std::ios_base::binary);
+        if (in) {
+            in.read((char*)save_buffer, ::save_capacity);
+            save_file_complete = in.gcount() == ::save_capacity;
+        }
     }
 }
 
@@ -6001,6 +7239,20 @@ Platform::~Platform()
 
     cleanup_point_light_cache();
     cleanup_charset_surfaces();
+
+    flush_save_data();
+    info(format("save data: % bytes written to disk", save_bytes_written));
+
+    info(format("glyph cache: % hits, % misses, % evictions",
+                glyph_cache_stats.hits_,
+                glyph_cache_stats.misses_,
+                glyph_cache_stats.evictions_));
+
+#ifndef _WIN32
+    if (save_mmapped) {
+        munmap(save_buffer, ::save_capacity);
+    }
+#endif
 }
 
 
@@ -0,0 +1,470 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2023 Evan Bowman
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/. */
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "profile.hpp"
+
+
+
+#if not defined(__GBA__) and not defined(__NDS__)
+
+
+#include "platform/platform.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+
+
+namespace profile
+{
+
+
+
+std::atomic<bool> enabled{false};
+
+// Whether we record per-frame zone times and trace events, or only the running
+// totals (see set_totals_enabled()).
+static std::atomic<bool> tracing{false};
+static bool totals_enabled = false;
+
+
+
+static const int ring_size = 120;
+static const u32 max_events_per_frame = 4096;
+static const int max_threads = 8;
+
+
+
+struct Event
+{
+    s64 start_ns_;
+    s64 duration_ns_;
+    ZoneId zone_;
+    u8 thread_;
+};
+
+
+
+struct ZoneTime
+{
+    s64 ns_ = 0;
+    u64 calls_ = 0;
+};
+
+
+
+struct Frame
+{
+    s64 start_ns_ = 0;
+    s64 end_ns_ = 0;
+    std::vector<Event> events_;
+    u32 dropped_ = 0;
+    ZoneTime zones_[max_zones];
+};
+
+
+
+// NOTE: With --pipeline, the update and the present run on different threads,
+// so everything below is guarded by the lock.
+static std::mutex lock;
+
+static const char* zone_names[max_zones];
+static int zone_count = 0;
+
+// NOTE: Running totals are kept per thread, and each thread only ever writes to
+// its own slots, so a zone can update them without taking the lock. Readers sum
+// the slots of every thread. The counters are atomic so that the reads don't
+// race with the writes, but as each has a single writer, updating one is a
+// relaxed load and store, rather than a locked read-modify-write.
+struct ThreadTotal
+{
+    std::atomic<s64> ns_{0};
+    std::atomic<u64> calls_{0};
+};
+
+static ThreadTotal thread_totals[max_threads][max_zones];
+
+// reset_totals() can't clear another thread's slots, so it records the sums at
+// the time of the reset instead.
+static ZoneTime totals_baseline[max_zones];
+
+static std::vector<Frame> frames;
+static int current_frame = 0;
+static int frames_completed = 0;
+
+static std::atomic<int> thread_count{0};
+static thread_local int thread_index = -1;
+static thread_local u32 zone_depth[max_zones];
+
+
+
+static s64 now_ns()
+{
+    namespace chrono = std::chrono;
+    auto clk = chrono::steady_clock::now().time_since_epoch();
+    return chrono::duration_cast<chrono::nanoseconds>(clk).count();
+}
+
+
+
+ZoneId register_zone(const char* name)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (int i = 0; i < zone_count; ++i) {
+        if (str_eq(zone_names[i], name)) {
+            return i;
+        }
+    }
+
+    if (zone_count == max_zones) {
+        Platform::fatal("too many profile zones!");
+    }
+
+    zone_names[zone_count] = name;
+    return zone_count++;
+}
+
+
+
+void Zone::enter()
+{
+    entered_ = true;
+
+    if (zone_depth[id_]++ == 0) {
+        start_ = now_ns();
+    } else {
+        // NOTE: A nested zone doesn't record anything, but it still needs to
+        // unwind the depth counter.
+        start_ = -1;
+    }
+}
+
+
+
+void Zone::exit()
+{
+    --zone_depth[id_];
+
+    if (start_ == -1) {
+        return;
+    }
+
+    const auto duration = now_ns() - start_;
+
+    if (thread_index == -1) {
+        thread_index = thread_count++;
+        if (thread_index >= max_threads) {
+            Platform::fatal("too many profiled threads!");
+        }
+    }
+
+    auto& total = thread_totals[thread_index][id_];
+    const auto relaxed = std::memory_order_relaxed;
+    total.ns_.store(total.ns_.load(relaxed) + duration, relaxed);
+    total.calls_.store(total.calls_.load(relaxed) + 1, relaxed);
+
+    if (not tracing.load(relaxed)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto& frame = frames[current_frame];
+    frame.zones_[id_].ns_ += duration;
+    ++frame.zones_[id_].calls_;
+
+    if (frame.events_.size() < max_events_per_frame) {
+        frame.events_.push_back({start_, duration, id_, (u8)thread_index});
+    } else {
+        ++frame.dropped_;
+    }
+}
+
+
+
+void set_enabled(bool on)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (on and frames.empty()) {
+        // NOTE: The event lists start out empty, and frame_boundary() sizes
+        // each one from the frame before it. Reserving max_events_per_frame
+        // for every frame in the ring up front would cost megabytes.
+        frames.resize(ring_size);
+        frames[current_frame].start_ns_ = now_ns();
+    }
+
+    tracing.store(on, std::memory_order_relaxed);
+    enabled.store(on or totals_enabled, std::memory_order_relaxed);
+}
+
+
+
+void set_totals_enabled(bool on)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    totals_enabled = on;
+
+    const auto relaxed = std::memory_order_relaxed;
+    enabled.store(on or tracing.load(relaxed), relaxed);
+}
+
+
+
+void frame_boundary()
+{
+    if (not tracing.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    const auto now = now_ns();
+
+    auto& prev = frames[current_frame];
+    prev.end_ns_ = now;
+
+    current_frame = (current_frame + 1) % ring_size;
+    frames_completed = std::min(frames_completed + 1, ring_size - 1);
+
+    auto& next = frames[current_frame];
+    next.start_ns_ = now;
+    next.end_ns_ = 0;
+    next.events_.clear();
+    next.events_.reserve(prev.events_.size());
+    next.dropped_ = 0;
+    for (auto& z : next.zones_) {
+        z = ZoneTime{};
+    }
+}
+
+
+
+// Sums each zone's running totals across all threads. Caller must hold the
+// lock.
+static void sum_totals(ZoneTime* out)
+{
+    for (int z = 0; z < max_zones; ++z) {
+        out[z] = ZoneTime{};
+        for (auto& thread : thread_totals) {
+            out[z].ns_ += thread[z].ns_.load(std::memory_order_relaxed);
+            out[z].calls_ += thread[z].calls_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
+
+void reset_totals()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    sum_totals(totals_baseline);
+}
+
+
+
+void for_each_total(Function<4 * sizeof(void*), void(const Totals&)> cb)
+{
+    int count;
+    ZoneTime copy[max_zones];
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        count = zone_count;
+        sum_totals(copy);
+        for (int i = 0; i < count; ++i) {
+            copy[i].ns_ -= totals_baseline[i].ns_;
+            copy[i].calls_ -= totals_baseline[i].calls_;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        Totals t{zone_names[i], copy[i].ns_, copy[i].calls_};
+        cb(t);
+    }
+}
+
+
+
+// Iterates over the completed frames in the ring, oldest first. Caller must
+// hold the lock.
+template <typename F> static void for_each_frame(F&& callback)
+{
+    for (int i = frames_completed; i > 0; --i) {
+        callback(frames[(current_frame - i + ring_size) % ring_size]);
+    }
+}
+
+
+
+void report(Function<4 * sizeof(void*), void(const char*)> cb)
+{
+    struct Summary
+    {
+        s64 total_ns_ = 0;
+        s64 worst_ns_ = 0;
+        u64 calls_ = 0;
+    };
+
+    Summary zones[max_zones];
+    Summary frame_time;
+    int frame_count = 0;
+    int zones_used;
+    u32 dropped = 0;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        zones_used = zone_count;
+
+        for_each_frame([&](Frame& f) {
+            ++frame_count;
+
+            const auto len = f.end_ns_ - f.start_ns_;
+            frame_time.total_ns_ += len;
+            frame_time.worst_ns_ = std::max(frame_time.worst_ns_, len);
+
+            for (int i = 0; i < zones_used; ++i) {
+                auto& z = zones[i];
+                z.total_ns_ += f.zones_[i].ns_;
+                z.worst_ns_ = std::max(z.worst_ns_, f.zones_[i].ns_);
+                z.calls_ += f.zones_[i].calls_;
+            }
+
+            dropped += f.dropped_;
+        });
+    }
+
+    if (frame_count == 0) {
+        cb("profile: no frames recorded, is profiling enabled?");
+        return;
+    }
+
+    char line[128];
+
+    snprintf(line,
+             sizeof line,
+             "profile: last %d frames, avg %.2f ms, worst %.2f ms",
+             frame_count,
+             frame_time.total_ns_ / 1e6 / frame_count,
+             frame_time.worst_ns_ / 1e6);
+    cb(line);
+
+    snprintf(line,
+             sizeof line,
+             "  %-24s %8s %8s %11s",
+             "zone",
+             "avg ms",
+             "max ms",
+             "calls/frame");
+    cb(line);
+
+    int order[max_zones];
+    for (int i = 0; i < zones_used; ++i) {
+        order[i] = i;
+    }
+    std::sort(order, order + zones_used, [&](int lhs, int rhs) {
+        return zones[lhs].total_ns_ > zones[rhs].total_ns_;
+    });
+
+    for (int i = 0; i < zones_used; ++i) {
+        auto& z = zones[order[i]];
+        if (z.calls_ == 0) {
+            continue;
+        }
+        snprintf(line,
+                 sizeof line,
+                 "  %-24s %8.3f %8.3f %11.1f",
+                 zone_names[order[i]],
+                 z.total_ns_ / 1e6 / frame_count,
+                 z.worst_ns_ / 1e6,
+                 (double)z.calls_ / frame_count);
+        cb(line);
+    }
+
+    if (dropped) {
+        snprintf(line,
+                 sizeof line,
+                 "  (%u events dropped from the trace, frames too busy)",
+                 dropped);
+        cb(line);
+    }
+}
+
+
+
+bool dump_trace(const char* path)
+{
+    FILE* out = fopen(path, "w");
+    if (not out) {
+        return false;
+    }
+
+    // Frame markers go on their own row in the trace viewer.
+    static const int frame_tid = 99;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    s64 epoch = -1;
+    for_each_frame([&](Frame& f) {
+        if (epoch == -1) {
+            epoch = f.start_ns_;
+        }
+    });
+
+    auto us = [&](s64 ns) { return (ns - epoch) / 1e3; };
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"frames\"}}",
+            frame_tid);
+
+    int frame_num = 0;
+
+    for_each_frame([&](Frame& f) {
+        fprintf(out,
+                ",\n{\"name\":\"frame %d\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                frame_num++,
+                frame_tid,
+                us(f.start_ns_),
+                (f.end_ns_ - f.start_ns_) / 1e3);
+
+        for (auto& e : f.events_) {
+            fprintf(out,
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    zone_names[e.zone_],
+                    e.thread_,
+                    us(e.start_ns_),
+                    e.duration_ns_ / 1e3);
+        }
+    });
+
+    fprintf(out, "\n]}\n");
+
+    return fclose(out) == 0;
+}
+
+
+
+} // namespace profile
+
+
+
+#endif
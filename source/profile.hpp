@@ -0,0 +1,205 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2023 Evan Bowman
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/. */
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "function.hpp"
+#include "number/int.h"
+#include "util.hpp"
+#include <atomic>
+
+
+
+// Scoped timers for the hot paths of the game, so that we can see where frame
+// time goes without reaching for an external profiler. Put a
+// PROFILE_ZONE("name") at the top of a function, and the zone records how long
+// the rest of the enclosing scope took.
+//
+// While profiling is off, a zone costs one branch. On the consoles, zones
+// compile to nothing.
+//
+// The profiler keeps the timings for the last few frames in a ring buffer.
+// From there, we can print a per-zone summary, or export the frames as a
+// Chrome trace (load the json file in chrome://tracing, or in Perfetto). The
+// profiler also keeps running totals for each zone, which the --bench mode
+// reports. The totals can be turned on by themselves, and are much cheaper to
+// keep than the frame ring: zones update them without taking a lock, and
+// record no trace events.
+//
+// When a zone nests inside another zone with the same name (recursive lisp
+// calls, for example), only the outermost one counts. Zones with different
+// names do not exclude one another, so a parent zone's time includes the time
+// of its children.
+
+
+
+#if defined(__GBA__) or defined(__NDS__)
+
+
+#define PROFILE_ZONE(NAME)
+
+
+
+namespace profile
+{
+
+
+
+inline void set_enabled(bool)
+{
+}
+
+
+
+inline void frame_boundary()
+{
+}
+
+
+
+inline void report(Function<4 * sizeof(void*), void(const char*)> cb)
+{
+    cb("profiling is only supported in desktop builds");
+}
+
+
+
+inline bool dump_trace(const char*)
+{
+    return false;
+}
+
+
+
+} // namespace profile
+
+
+#else
+
+
+#define PROFILE_CONCAT_IMPL(A, B) A##B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_IMPL(A, B)
+
+
+#define PROFILE_ZONE(NAME)                                                     \
+    static const profile::ZoneId PROFILE_CONCAT(profile_id_, __LINE__) =       \
+        profile::register_zone(NAME);                                          \
+    profile::Zone PROFILE_CONCAT(profile_zone_, __LINE__)(                     \
+        PROFILE_CONCAT(profile_id_, __LINE__))
+
+
+
+namespace profile
+{
+
+
+
+using ZoneId = u8;
+
+
+
+static constexpr const int max_zones = 32;
+
+
+
+// NOTE: Zones read this on every thread that runs game code, so it's atomic.
+// The read is relaxed: a zone that misses the change just records (or skips)
+// one more sample.
+extern std::atomic<bool> enabled;
+
+
+
+// Returns the id for a zone name, registering the zone if it doesn't exist
+// yet. Zones with the same name share an id.
+ZoneId register_zone(const char* name);
+
+
+
+class Zone
+{
+public:
+    Zone(ZoneId id) : id_(id)
+    {
+        if (UNLIKELY(enabled.load(std::memory_order_relaxed))) {
+            enter();
+        }
+    }
+
+
+    Zone(const Zone&) = delete;
+
+
+    ~Zone()
+    {
+        if (UNLIKELY(entered_)) {
+            exit();
+        }
+    }
+
+
+private:
+    void enter();
+    void exit();
+
+    ZoneId id_;
+    bool entered_ = false;
+    s64 start_ = 0;
+};
+
+
+
+// Turns on the frame ring and trace events, as well as the running totals.
+void set_enabled(bool on);
+
+
+
+// Turns on only the running totals.
+void set_totals_enabled(bool on);
+
+
+
+// Closes the current frame in the ring buffer, and starts a new one. Called
+// once per iteration of the main loop.
+void frame_boundary();
+
+
+
+struct Totals
+{
+    const char* name_;
+    s64 total_ns_;
+    u64 calls_;
+};
+
+
+
+// Running totals, accumulated since the last call to reset_totals().
+void reset_totals();
+void for_each_total(Function<4 * sizeof(void*), void(const Totals&)> cb);
+
+
+
+// Summarizes the frames in the ring buffer: average and worst time per frame
+// for each zone.
+void report(Function<4 * sizeof(void*), void(const char*)> cb);
+
+
+
+// Writes the frames in the ring buffer to a file in the Chrome trace event
+// format. Returns false if the file could not be written.
+bool dump_trace(const char* path);
+
+
+
+} // namespace profile
+
+
+#endif
@@ -62,11 +62,9 @@ Vector<u8> decode(Vector<u8>& data)
             result.clear();
             return result;
         }
-        const u8 val = *it;
-        while (count) {
-            --count;
-            result.push_back(val);
-        }
+        u8 run[255];
+        memset(run, *it, count);
+        result.append(run, count);
         ++it;
     }
 
@@ -1990,6 +1990,11 @@ Value* builtin_disassemble(int argc)
 
             case LexicalVarLoad::op():
                 out += LexicalVarLoad::name();
+                out += "(";
+                out += stringify(((LexicalVarLoad*)(data->data_ + i))->frame_);
+                out += ", ";
+                out += stringify(((LexicalVarLoad*)(data->data_ + i))->slot_);
+                out += ")";
                 i += sizeof(LexicalVarLoad);
                 break;
 
@@ -119,6 +119,108 @@ inline instruction::Header* load_instruction(ScratchBuffer& buffer, int index)
 
 struct CompilerContext
 {
+    // Tracks the symbols bound by let expressions enclosing the expression
+    // currently being compiled. Because the layout of the lexical environment
+    // at any point within a compiled function is fixed, the compiler can
+    // resolve references to let-bound variables ahead of time, emitting a
+    // LEXICAL_VAR_LOAD with a (frame, slot) pair rather than a LOAD_VAR, which
+    // would need to search the environment by name at runtime.
+    struct Frame
+    {
+        u8 begin_;
+
+        // A frame is open while we're still compiling its bindings. A lambda
+        // defined within an open frame captures the frame before the let
+        // finishes binding variables, so slot offsets computed when compiling
+        // the lambda would not be accurate by the time that it's called.
+        bool open_;
+    };
+
+    Buffer<Symbol::UniqueId, 48> bindings_;
+    Buffer<Frame, 16> frames_;
+
+    // Number of frames in scope at the start of the innermost lambda that
+    // we're compiling.
+    u8 lambda_frame_floor_ = 0;
+
+    // If we ever run out of space to track bindings, we cannot reliably compute
+    // slot offsets for the remainder of the function, and fall back to runtime
+    // variable lookup.
+    bool scope_overflow_ = false;
+
+
+    void frame_push()
+    {
+        if (not frames_.push_back({(u8)bindings_.size(), true})) {
+            scope_overflow_ = true;
+        }
+    }
+
+
+    void frame_close()
+    {
+        if (not scope_overflow_) {
+            frames_.back().open_ = false;
+        }
+    }
+
+
+    void frame_pop()
+    {
+        if (scope_overflow_) {
+            return;
+        }
+        while (bindings_.size() > frames_.back().begin_) {
+            bindings_.pop_back();
+        }
+        frames_.pop_back();
+    }
+
+
+    void bind(Symbol::UniqueId id)
+    {
+        if (scope_overflow_) {
+            return;
+        }
+        if (not bindings_.push_back(id)) {
+            scope_overflow_ = true;
+        }
+    }
+
+
+    using FrameSlot = std::pair<u8, u8>;
+
+
+    Optional<FrameSlot> find(Symbol::UniqueId id)
+    {
+        if (scope_overflow_) {
+            return nullopt();
+        }
+
+        int end = bindings_.size();
+        u8 frame = 0;
+
+        for (int f = frames_.size() - 1; f > -1; --f) {
+            if (frames_[f].open_ and f < lambda_frame_floor_) {
+                // The frame may receive more bindings, possibly shadowing the
+                // variable, before the enclosing lambda runs.
+                return nullopt();
+            }
+            const int begin = frames_[f].begin_;
+            // NOTE: the vm conses each new binding onto the front of the
+            // frame's binding list, so the most recent binding is at slot
+            // zero.
+            for (int i = end - 1; i >= begin; --i) {
+                if (bindings_[i] == id) {
+                    return FrameSlot{frame, (u8)((end - 1) - i)};
+                }
+            }
+            end = begin;
+            ++frame;
+        }
+
+        return nullopt();
+    }
 };
 
 
@@ -254,6 +356,7 @@ int compile_let(CompilerContext& ctx,
 
     if (binding_count not_eq 0) {
         append<instruction::LexicalFramePush>(buffer, write_pos);
+        ctx.frame_push();
     }
 
     l_foreach(code->cons().car(), [&](Value* val) {
@@ -275,6 +378,7 @@ int compile_let(CompilerContext& ctx,
 
                     auto name = sym->symbol().name();
                     memcpy(inst->name_, name, Symbol::buffer_size);
+                    ctx.bind(sym->symbol().unique_id());
 
                 } else if (small_sym and
                            bindv->type() == Value::Type::symbol and
@@ -285,6 +389,7 @@ int compile_let(CompilerContext& ctx,
 
                     auto name = sym->symbol().name();
                     memcpy(inst->name_, name, Symbol::buffer_size);
+                    ctx.bind(sym->symbol().unique_id());
 
                 } else if (small_sym and
                            bindv->type() == Value::Type::symbol and
@@ -295,6 +400,7 @@ int compile_let(CompilerContext& ctx,
 
                     auto name = sym->symbol().name();
                     memcpy(inst->name_, name, Symbol::buffer_size);
+                    ctx.bind(sym->symbol().unique_id());
 
                 } else {
                     write_pos = compile_impl(ctx,
@@ -314,6 +420,7 @@ int compile_let(CompilerContext& ctx,
                             append<instruction::LexicalDef>(buffer, write_pos);
                         inst->ptr_.set(sym->symbol().name());
                     }
+                    ctx.bind(sym->symbol().unique_id());
                 }
             } else if (sym->type() == Value::Type::cons) {
                 PLATFORM.fatal("destructuring let unimplemented for compiled "
@@ -322,6 +429,10 @@ int compile_let(CompilerContext& ctx,
         }
     });
 
+    if (binding_count not_eq 0) {
+        ctx.frame_close();
+    }
+
     code = code->cons().cdr();
 
     bool first = true;
@@ -344,6 +455,7 @@ int compile_let(CompilerContext& ctx,
 
     if (binding_count not_eq 0) {
         append<instruction::LexicalFramePop>(buffer, write_pos);
+        ctx.frame_pop();
     }
 
     return write_pos;
@@ -432,20 +544,26 @@ TOP:
                 break;
             }
 
+        } else if (auto local = ctx.find(code->symbol().unique_id())) {
+
+            // The variable was bound by a let expression within the function
+            // that we're compiling, so we already know exactly where it lives
+            // in the lexical environment.
+            auto inst = append<instruction::LexicalVarLoad>(buffer, write_pos);
+            inst->frame_ = local->first;
+            inst->slot_ = local->second;
+
         } else {
 
-            // It's not worth optimizing variable loading at compile time very
-            // much. Why not optimize in the compiler? Because the compiler then
-            // needs to be more complicated; it'd need to understand stuff like
-            // variable scope. The runtime already has info about local/global
-            // variable scope and can perform the optimization without me
-            // needing to duplicate the variable referencing logic in the
-            // compiler. So we just emit an instruction LOAD_VAR with the
-            // address of the string name of the variable (which is safe,
-            // because the symbol string is internalized), and the bytecode vm
-            // substitutes a different instruction with stack information, or
-            // the address of a builtin function, depending on where the runtime
-            // finds the variable.
+            // For anything not bound locally within the function being
+            // compiled, we just emit an instruction LOAD_VAR with the address
+            // of the string name of the variable (which is safe, because the
+            // symbol string is internalized), and the bytecode vm substitutes a
+            // different instruction with stack information, or the address of
+            // a builtin function, depending on where the runtime finds the
+            // variable. The runtime knows about variables captured from the
+            // environment in which the function was defined, while the compiler
+            // does not.
 
             if (code->symbol().hdr_.mode_bits_ == (u8)Symbol::ModeBits::small) {
                 auto inst =
@@ -546,6 +664,9 @@ TOP:
 
             auto lambda_start_pos = write_pos;
 
+            const auto prev_lambda_frame_floor = ctx.lambda_frame_floor_;
+            ctx.lambda_frame_floor_ = ctx.frames_.size();
+
             bool first = true;
 
             if (length(lat) == 0) {
@@ -578,6 +699,8 @@ TOP:
 
             append<instruction::Ret>(buffer, write_pos);
 
+            ctx.lambda_frame_floor_ = prev_lambda_frame_floor;
+
             lambda->lambda_end_.set(write_pos - jump_offset);
 
         } else if (fn->type() == Value::Type::symbol and
@@ -15,6 +15,7 @@
 #include "debug.hpp"
 #include "eternal/eternal.hpp"
 #include "ext_workram_data.hpp"
+#include "fnv.hpp"
 #include "lisp_internal.hpp"
 #include "listBuilder.hpp"
 #include "localization.hpp"
@@ -23,6 +24,7 @@
 #include "number/random.hpp"
 #include "number/ratio.hpp"
 #include "platform/libc.hpp"
+#include "profile.hpp"
 #include "vm.hpp"
 
 #if not MAPBOX_ETERNAL_IS_CONSTEXPR
@@ -40,6 +42,17 @@ namespace lisp
 static const u32 string_intern_table_size = 2000;
 
 
+// Capacity of the hash index over the string intern table. Must be a power of
+// two. Desktop builds may override the default.
+#if defined(__GBA__) or defined(__NDS__)
+#define STRING_INTERN_INDEX_SIZE 512
+#elif not defined(STRING_INTERN_INDEX_SIZE)
+#define STRING_INTERN_INDEX_SIZE 1024
+#endif
+
+static_assert((STRING_INTERN_INDEX_SIZE & (STRING_INTERN_INDEX_SIZE - 1)) == 0);
+
+
 #if defined(__NDS__)
 #define VALUE_POOL_SIZE 20000
 #elif defined(__GBA__)
@@ -50,6 +63,17 @@ static const u32 string_intern_table_size = 2000;
 
 #define SYMBOL_CACHE_SIZE 8
 
+#if defined(__GBA__) or defined(__NDS__)
+#define BUILTIN_CACHE_SIZE 64
+#define CONSTANT_TAB_INDEX_SIZE 64
+#define DOSTRING_CACHE_SIZE 0
+#else
+#define BUILTIN_CACHE_SIZE 256
+#define CONSTANT_TAB_INDEX_SIZE 512
+#define DOSTRING_CACHE_SIZE 32
+#define DOSTRING_CACHE_CELLS (VALUE_POOL_SIZE / 8)
+#endif
+
 
 union ValueMemory
 {
@@ -84,10 +108,32 @@ static EXT_WORKRAM_DATA ValueMemory value_pool_data[VALUE_POOL_SIZE];
 static Value* value_pool = nullptr;
 
 
+// NOTE: The collector sweeps the value pool incrementally. After the mark
+// phase, we only sweep as much of the pool as we need to refill the free list,
+// and the rest of the pool gets swept in small chunks whenever we run low on
+// values again. Every value beyond the sweep cursor was either marked during
+// the last mark phase, or allocated afterwards, so alloc_value() sets the mark
+// bit of values allocated beyond the cursor, to keep the sweep from collecting
+// them.
+static constexpr const int gc_sweep_chunk = 256;
+static int gc_sweep_cursor = VALUE_POOL_SIZE;
+static bool gc_running;
+
+static u32 gc_collections;
+static u32 gc_reclaimed;
+static u32 gc_last_reclaimed;
+static u32 gc_sweep_used;
+static Microseconds gc_last_pause;
+static Microseconds gc_max_pause;
+
+
+static void gc_incremental();
+
+
 static inline void gc_safepoint()
 {
     if (value_remaining_count < early_gc_threshold) {
-        gc();
+        gc_incremental();
     }
 }
 
@@ -117,6 +163,14 @@ struct StringInternTable
 };
 
 
+// Open addressing hash index over the string intern table. Each slot stores the
+// offset of an interned string plus one, zero marks an empty slot.
+struct StringInternIndex
+{
+    u16 slots_[STRING_INTERN_INDEX_SIZE];
+};
+
+
 const char* intern(const char* string);
 
 
@@ -131,16 +185,17 @@ void Function::Signature::reset()
 }
 
 
-std::pair<ValuePoolUsed, ValuePoolFree> value_pool_info()
+ValuePoolInfo value_pool_info()
 {
-    int values_remaining = 0;
-    Value* current = value_pool;
-    while (current) {
-        ++values_remaining;
-        current = current->heap_node().next_;
-    }
+    ValuePoolInfo info;
+    info.used_ = VALUE_POOL_SIZE - value_remaining_count;
+    info.free_ = value_remaining_count;
+    info.collections_ = gc_collections;
+    info.last_reclaimed_ = gc_last_reclaimed;
+    info.last_pause_ = gc_last_pause;
+    info.max_pause_ = gc_max_pause;
 
-    return {VALUE_POOL_SIZE - values_remaining, values_remaining};
+    return info;
 }
 
 
@@ -234,12 +289,21 @@ struct Context
     // If the game was built with a correctly formatted symbol lookup table,
     // then this in-memory table should never be needed...
     Optional<DynamicMemory<StringInternTable>> string_intern_table_;
+    Optional<DynamicMemory<StringInternIndex>> string_intern_index_;
+    u16 string_intern_index_count_ = 0;
+    // Interned strings below this offset have been added to the index. If the
+    // index fills up, strings beyond the offset can only be found by scanning.
+    int string_intern_indexed_pos_ = 0;
     Optional<debug::DebugHandler> debug_handler_;
     Value* debug_breakpoints_ = nullptr;
     Value* debug_watchpoints_ = nullptr;
 
     Value* nil_ = nullptr;
     Value* string_buffer_ = nullptr;
+
+    // Expressions read by dostring_cached(), as a list of
+    // (hash length cells (offset . expr) ...), most recently used first.
+    Value* dostring_cache_ = nullptr;
     Value* globals_tree_ = nullptr;
     Value* tree_nullnode_ = nullptr;
 
@@ -258,12 +322,30 @@ struct Context
     u8 symbol_cache_index_ = 0;
 #endif
 
+    // Boxed function values for builtins and native interface functions,
+    // indexed by a hash of the function pointer. Without the cache, every
+    // reference to a builtin allocates a new function value.
+    Value* builtin_cache_[BUILTIN_CACHE_SIZE];
+    u32 builtin_cache_hits_ = 0;
+    u32 builtin_cache_misses_ = 0;
+
     const char* external_symtab_contents_ = nullptr;
     u32 external_symtab_size_;
 
     const char* external_constant_tab_ = nullptr;
     u32 external_constant_tab_size_;
 
+    // Index of the external constant table, sorted by name. A constant's
+    // value is evaluated on first access and memoized. If the table does not
+    // fit in the index, get_var() falls back to scanning the table.
+    struct ConstantTabIndexEntry
+    {
+        u16 offset_;
+        Value* value_;
+    };
+    Buffer<ConstantTabIndexEntry, CONSTANT_TAB_INDEX_SIZE> constant_tab_index_;
+    bool constant_tab_indexed_ = false;
+
     NativeInterface native_interface_;
 
     int string_intern_pos_ = 0;
@@ -824,7 +906,9 @@ constexpr bool is_powerof2(int v)
 Value* alloc_value()
 {
     auto init_val = [](Value* val) {
-        val->hdr_.mark_bit_ = false;
+        // See the note about incremental sweeping at the top of the file.
+        val->hdr_.mark_bit_ =
+            ((ValueMemory*)val - value_pool_data) >= gc_sweep_cursor;
         val->hdr_.alive_ = true;
         return val;
     };
@@ -845,7 +929,7 @@ Value* alloc_value()
     // of things call alloc_value, meaning there's lots of code to comb through
     // for gc bugs. We do preemptively invoke the gc when we're running low in
     // some places to avoid having to do this...
-    gc();
+    gc_incremental();
 
     // Hopefully, we've freed up enough memory...
     if (auto val = value_pool_alloc()) {
@@ -1769,6 +1853,8 @@ RestoreDebugBreak debug_break_compiled_fn(Value* obj)
 // the result of the function call.
 void funcall(Value* obj, u8 argc)
 {
+    PROFILE_ZONE("lisp::eval");
+
     auto pop_args = [&argc] {
         for (int i = 0; i < argc; ++i) {
             L_CTX.operand_stack_->pop_back();
@@ -2633,8 +2719,10 @@ Value* dostring(const char* code)
 }
 
 
-Value* dostring(CharSequence& code,
-                ::Function<4 * sizeof(void*), void(Value&)> on_error)
+static Value*
+dostring_impl(CharSequence& code,
+              ::Function<4 * sizeof(void*), void(Value&)>& on_error,
+              ListBuilder* record)
 {
     int i = 0;
 
@@ -2658,6 +2746,10 @@ Value* dostring(CharSequence& code,
             pop_op();
             break;
         }
+        if (record) {
+            Protected offset(L_INT(last_i));
+            record->push_back(L_CONS(offset, reader_result));
+        }
         eval(reader_result);
         auto expr_result = get_op0();
         result.set(expr_result);
@@ -2685,6 +2777,162 @@ Value* dostring(CharSequence& code,
 }
 
 
+Value* dostring(CharSequence& code,
+                ::Function<4 * sizeof(void*), void(Value&)> on_error)
+{
+    return dostring_impl(code, on_error, nullptr);
+}
+
+
+static Value*
+doforms(Value* forms,
+        CharSequence& code,
+        ::Function<4 * sizeof(void*), void(Value&)>& on_error)
+{
+    Protected result(get_nil());
+    Protected current(forms);
+
+    auto prev_stk = L_CTX.operand_stack_->size();
+
+    while (current not_eq get_nil()) {
+        auto form = current->cons().car();
+        eval(form->cons().cdr());
+        auto expr_result = get_op0();
+        result.set(expr_result);
+        pop_op(); // expression result
+
+        if (is_error(expr_result)) {
+            result = expr_result;
+            const auto offset = form->cons().car()->integer().value_;
+            const auto current_line = error_find_linenum(code, offset);
+            error_append_line_hint(expr_result->error(), current_line);
+            expr_result->error().stacktrace_ = compr(L_NIL);
+            push_op(expr_result);
+            on_error(*expr_result);
+            pop_op();
+            break;
+        }
+
+        current = current->cons().cdr();
+        gc_safepoint();
+    }
+
+    if (L_CTX.strict_ and L_CTX.operand_stack_->size() not_eq prev_stk) {
+        PLATFORM.fatal(::format(
+            "stack spill! % %", L_CTX.operand_stack_->size(), prev_stk));
+    }
+
+    return result;
+}
+
+
+// Roughly how many values an expression keeps alive.
+static int count_cells(Value* val)
+{
+    int count = 1;
+    while (val->type() == Value::Type::cons) {
+        count += 1 + count_cells(val->cons().car());
+        val = val->cons().cdr();
+    }
+    return count;
+}
+
+
+Value* dostring_cached(CharSequence& code,
+                       ::Function<4 * sizeof(void*), void(Value&)> on_error)
+{
+    if (DOSTRING_CACHE_SIZE == 0) {
+        return dostring(code, on_error);
+    }
+
+    // NOTE: fnv32, but CharSequence doesn't give us contiguous memory.
+    u32 hash = 2166136261U;
+    int length = 0;
+    for (; code[length] not_eq '\0'; ++length) {
+        hash ^= (u8)code[length];
+        hash *= 16777619;
+    }
+
+    // NOTE: An entry looks like (hash length cells . forms). Comparing the
+    // length as well as the hash makes a collision far less likely to run some
+    // other script's code.
+    auto entry_hash = [](Value* entry) {
+        return (u32)entry->cons().car()->integer().value_;
+    };
+    auto entry_length = [](Value* entry) {
+        return entry->cons().cdr()->cons().car()->integer().value_;
+    };
+    auto entry_cells = [](Value* entry) {
+        auto cells = entry->cons().cdr()->cons().cdr()->cons().car();
+        return cells->integer().value_;
+    };
+    auto entry_forms = [](Value* entry) {
+        return entry->cons().cdr()->cons().cdr()->cons().cdr();
+    };
+
+    Value* prev = nullptr;
+    Value* current = L_CTX.dostring_cache_;
+    while (current not_eq get_nil()) {
+        auto entry = current->cons().car();
+        if (entry_hash(entry) == hash and entry_length(entry) == length) {
+            if (prev) {
+                // Move the entry to the front of the list.
+                prev->cons().set_cdr(current->cons().cdr());
+                current->cons().set_cdr(L_CTX.dostring_cache_);
+                L_CTX.dostring_cache_ = current;
+            }
+            return doforms(entry_forms(entry), code, on_error);
+        }
+        prev = current;
+        current = current->cons().cdr();
+    }
+
+    ListBuilder forms;
+    Protected result(dostring_impl(code, on_error, &forms));
+
+    if (is_error(result)) {
+        // Don't cache anything, the code may not have been read in its
+        // entirety.
+        return result;
+    }
+
+    const int cells = count_cells(forms.result());
+    if (cells > DOSTRING_CACHE_CELLS) {
+        // Too big to be worth keeping around.
+        return result;
+    }
+
+    {
+        Protected entry(L_CONS(L_INT(cells), forms.result()));
+        entry = L_CONS(L_INT(length), entry);
+        entry = L_CONS(L_INT(hash), entry);
+        L_CTX.dostring_cache_ = L_CONS(entry, L_CTX.dostring_cache_);
+    }
+
+    // Evict the least recently used entries once we're over either the entry
+    // limit or the cell budget.
+    int count = 0;
+    int total_cells = 0;
+    current = L_CTX.dostring_cache_;
+    while (current not_eq get_nil()) {
+        total_cells += entry_cells(current->cons().car());
+        auto next = current->cons().cdr();
+        if (next == get_nil()) {
+            break;
+        }
+        if (++count == DOSTRING_CACHE_SIZE or
+            total_cells + entry_cells(next->cons().car()) >
+                DOSTRING_CACHE_CELLS) {
+            current->cons().set_cdr(get_nil());
+            break;
+        }
+        current = next;
+    }
+
+    return result;
+}
+
+
 void format_impl(Value* value, Printer& p, int depth, bool skip_quotes = false)
 {
     if (not value->hdr_.alive_) {
@@ -3046,6 +3294,7 @@ static void gc_mark()
     gc_mark_value(L_CTX.nil_);
     gc_mark_value(L_CTX.lexical_bindings_);
     gc_mark_value(L_CTX.macros_);
+    gc_mark_value(L_CTX.dostring_cache_);
     gc_mark_value(L_CTX.tree_nullnode_);
     gc_mark_value(L_CTX.debug_breakpoints_);
     gc_mark_value(L_CTX.debug_watchpoints_);
@@ -3060,6 +3309,16 @@ static void gc_mark()
     }
 #endif
 
+    for (auto v : L_CTX.builtin_cache_) {
+        gc_mark_value(v);
+    }
+
+    for (auto& entry : L_CTX.constant_tab_index_) {
+        if (entry.value_) {
+            gc_mark_value(entry.value_);
+        }
+    }
+
     for (auto elem : *L_CTX.operand_stack_) {
         gc_mark_value(elem);
     }
@@ -3161,24 +3420,59 @@ int compact_string_memory()
 }
 
 
-static int gc_sweep()
+static void gc_mark_phase()
 {
+    l_foreach(get_var("--autoload-symbols"), [](Value* sym) {
+        if (sym->type() == Value::Type::symbol) {
+            if (globals_tree_find(sym)) {
+                globals_tree_erase(sym);
+            }
+        }
+    });
+
+    gc_mark();
+
     if (not L_CTX.string_buffer_->hdr_.mark_bit_) {
         L_CTX.string_buffer_ = L_NIL;
         L_CTX.string_buffer_remaining_ = 0;
     }
 
+    ++gc_collections;
+    gc_reclaimed = 0;
+    gc_sweep_used = 0;
+    gc_sweep_cursor = 0;
+}
+
+
+static bool gc_sweep_pending()
+{
+    return gc_sweep_cursor < VALUE_POOL_SIZE;
+}
+
+
+// Sweeps up to count values, starting from the sweep cursor. Returns the number
+// of values collected.
+static int gc_sweep(int count)
+{
+    if (not gc_sweep_pending()) {
+        return 0;
+    }
+
     int collect_count = 0;
-    u32 used_count = 0;
 
-    for (int i = 0; i < VALUE_POOL_SIZE; ++i) {
+    int end = gc_sweep_cursor + count;
+    if (end > VALUE_POOL_SIZE) {
+        end = VALUE_POOL_SIZE;
+    }
 
-        Value* val = (Value*)&value_pool_data[i];
+    for (; gc_sweep_cursor < end; ++gc_sweep_cursor) {
+
+        Value* val = (Value*)&value_pool_data[gc_sweep_cursor];
 
         if (val->hdr_.alive_) {
             if (val->hdr_.mark_bit_) {
                 val->hdr_.mark_bit_ = false;
-                ++used_count;
+                ++gc_sweep_used;
             } else {
 #ifdef MEM_PTR_TRACE
                 std::cout << ::format("free % ", (int)(intptr_t)val).c_str()
@@ -3190,21 +3484,85 @@ static int gc_sweep()
         }
     }
 
-    L_CTX.callstack_untouched_ = true;
+    gc_reclaimed += collect_count;
 
-    if (used_count > L_CTX.alloc_highwater_) {
-        L_CTX.alloc_highwater_ = used_count;
-        info(::format("LISP mem %", used_count));
-    }
+    if (gc_sweep_cursor == VALUE_POOL_SIZE) {
+        L_CTX.callstack_untouched_ = true;
+        gc_last_reclaimed = gc_reclaimed;
 
-    collect_count += compact_string_memory();
+        if (gc_sweep_used > L_CTX.alloc_highwater_) {
+            L_CTX.alloc_highwater_ = gc_sweep_used;
+            info(::format("LISP mem %", gc_sweep_used));
+        }
+    }
 
     return collect_count;
 }
 
 
+static void gc_record_pause(Platform::DeltaClock::TimePoint start)
+{
+    auto pause =
+        Platform::DeltaClock::duration(start, PLATFORM.delta_clock().sample());
+
+    gc_last_pause = pause;
+    if (pause > gc_max_pause) {
+        gc_max_pause = pause;
+    }
+}
+
+
+static void gc_incremental()
+{
+    if (gc_running) {
+        return;
+    }
+
+    PROFILE_ZONE("lisp::gc");
+
+    gc_running = true;
+
+    const auto start = PLATFORM.delta_clock().sample();
+
+    bool marked = false;
+
+    while (value_remaining_count < early_gc_threshold) {
+        if (not gc_sweep_pending()) {
+            if (marked) {
+                if (L_CTX.dostring_cache_ not_eq get_nil()) {
+                    // NOTE: Still short on values after collecting the whole
+                    // pool. The script cache is only an optimization, so drop
+                    // it, and collect again.
+                    L_CTX.dostring_cache_ = get_nil();
+                    gc_mark_phase();
+                    continue;
+                }
+                // We just collected the whole pool, there's nothing else that
+                // we can do.
+                break;
+            }
+            gc_mark_phase();
+            marked = true;
+        }
+        gc_sweep(gc_sweep_chunk);
+    }
+
+    gc_record_pause(start);
+
+    gc_running = false;
+}
+
+
 void live_values(::Function<6 * sizeof(void*), void(Value&)> callback)
 {
+    if (gc_sweep_pending() and not gc_running) {
+        // Otherwise, we'd hand out unreachable values that haven't been swept
+        // yet.
+        gc_running = true;
+        gc_sweep(VALUE_POOL_SIZE);
+        gc_running = false;
+    }
+
     for (int i = 0; i < VALUE_POOL_SIZE; ++i) {
 
         Value* val = (Value*)&value_pool_data[i];
@@ -3216,24 +3574,32 @@ void live_values(::Function<6 * sizeof(void*), void(Value&)> callback)
 }
 
 
-static bool gc_running;
 int gc()
 {
     if (gc_running) {
         return 0;
     }
+
+    PROFILE_ZONE("lisp::gc");
+
     gc_running = true;
 
-    l_foreach(get_var("--autoload-symbols"), [](Value* sym) {
-        if (sym->type() == Value::Type::symbol) {
-            if (globals_tree_find(sym)) {
-                globals_tree_erase(sym);
-            }
-        }
-    });
+    const auto start = PLATFORM.delta_clock().sample();
+
+    // Finish sweeping any garbage left over from an incremental collection.
+    int collect_count = gc_sweep(VALUE_POOL_SIZE);
+
+    gc_mark_phase();
+    collect_count += gc_sweep(VALUE_POOL_SIZE);
+
+    // NOTE: Compacting string memory moves strings around, so we only do it in
+    // a full collection, never in the incremental steps, which may run in the
+    // middle of allocating a string. If we run out of scratch buffers due to
+    // fragmentation, make_databuffer() will invoke a full collection.
+    collect_count += compact_string_memory();
+
+    gc_record_pause(start);
 
-    gc_mark();
-    int collect_count = gc_sweep();
     gc_running = false;
 
     return collect_count;
@@ -4183,6 +4549,8 @@ bool can_suspend(EvalStack& eval_stack, StringBuffer<48>& agitant)
 
 void eval(Value* code_root)
 {
+    PROFILE_ZONE("lisp::eval");
+
     push_op(code_root); // gc protect
 
     EvalStack eval_stack(make_scratch_buffer("eval-stack-buffer"));
@@ -5486,6 +5854,96 @@ struct ConstantTabEntryHeader
 };
 
 
+static const char* constant_tab_name(u16 offset)
+{
+    return L_CTX.external_constant_tab_ + offset +
+           sizeof(ConstantTabEntryHeader);
+}
+
+
+static void constant_tab_index_init()
+{
+    auto& index = L_CTX.constant_tab_index_;
+
+    u32 i = 0;
+    while (i < L_CTX.external_constant_tab_size_) {
+        auto ptr = L_CTX.external_constant_tab_ + i;
+        u8 name_size = ((ConstantTabEntryHeader*)ptr)->field_size_;
+        u8 value_size = ((ConstantTabEntryHeader*)ptr)->value_size_;
+
+        if (i > 0xffff or index.full()) {
+            info("constant tab exceeds index capacity");
+            index.clear();
+            return;
+        }
+
+        const char* name = ptr + sizeof(ConstantTabEntryHeader);
+
+        // The table is small, and only indexed once, so an insertion sort is
+        // fine here.
+        auto pos = index.begin();
+        while (pos not_eq index.end() and
+               str_cmp(constant_tab_name(pos->offset_), name) < 0) {
+            ++pos;
+        }
+        index.insert(pos, {(u16)i, nullptr});
+
+        i += sizeof(ConstantTabEntryHeader) + name_size + value_size;
+    }
+
+    L_CTX.constant_tab_indexed_ = true;
+}
+
+
+static Value* load_constant(const char* name)
+{
+    if (L_CTX.constant_tab_indexed_) {
+        auto& index = L_CTX.constant_tab_index_;
+        u32 left = 0;
+        u32 right = index.size();
+
+        while (left < right) {
+            u32 mid = left + (right - left) / 2;
+            auto& entry = index[mid];
+
+            int cmp = str_cmp(constant_tab_name(entry.offset_), name);
+            if (cmp == 0) {
+                if (not entry.value_) {
+                    auto ptr = L_CTX.external_constant_tab_ + entry.offset_;
+                    u8 name_size = ((ConstantTabEntryHeader*)ptr)->field_size_;
+                    auto v = dostring(ptr + sizeof(ConstantTabEntryHeader) +
+                                      name_size);
+                    if (is_error(v)) {
+                        return v;
+                    }
+                    entry.value_ = v;
+                }
+                return entry.value_;
+            } else if (cmp < 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+
+        return nullptr;
+    }
+
+    u32 i = 0;
+    for (; i < L_CTX.external_constant_tab_size_;) {
+        auto ptr = L_CTX.external_constant_tab_ + i;
+        u8 name_size = ((ConstantTabEntryHeader*)ptr)->field_size_;
+        u8 value_size = ((ConstantTabEntryHeader*)ptr)->value_size_;
+        if (str_eq(ptr + sizeof(ConstantTabEntryHeader), name)) {
+            return dostring(ptr + sizeof(ConstantTabEntryHeader) + name_size);
+        }
+        i += sizeof(ConstantTabEntryHeader) + name_size + value_size;
+    }
+
+    return nullptr;
+}
+
+
 void apropos(const char* match, Vector<const char*>& completion_strs)
 {
     StringBuffer<16> ident(match);
@@ -5812,17 +6270,21 @@ BUILTIN_TABLE(
      {"lisp-mem-string-internb",
       {SIG0(integer),
        [](int argc) { return L_INT(L_CTX.string_intern_pos_); }}},
+     {"lisp-mem-builtin-cache",
+      {SIG0(cons),
+       [](int argc) {
+           auto info = builtin_cache_info();
+           return L_CONS(L_INT(info.first), L_INT(info.second));
+       }}},
      {"lisp-mem-sbr-used",
       {SIG0(integer),
        [](int argc) {
            int databuffers = 0;
-           for (int i = 0; i < VALUE_POOL_SIZE; ++i) {
-               Value* val = (Value*)&value_pool_data[i];
-               if (val->hdr_.alive_ and
-                   val->hdr_.type_ == Value::Type::databuffer) {
+           live_values([&databuffers](Value& val) {
+               if (val.hdr_.type_ == Value::Type::databuffer) {
                    ++databuffers;
                }
-           }
+           });
            return L_INT(databuffers);
        }}},
      {"breakpoint",
@@ -5968,6 +6430,35 @@ void get_env(SymbolCallback callback)
 
 
 
+static const char* intern_table_find(const char* string, u32 len)
+{
+    const char* data = (*L_CTX.string_intern_table_)->data_;
+
+    auto& slots = (*L_CTX.string_intern_index_)->slots_;
+    const u32 mask = STRING_INTERN_INDEX_SIZE - 1;
+
+    for (u32 i = fnv32(string, len) & mask; slots[i]; i = (i + 1) & mask) {
+        if (str_eq(data + slots[i] - 1, string)) {
+            return data + slots[i] - 1;
+        }
+    }
+
+    for (int i = L_CTX.string_intern_indexed_pos_;
+         i < L_CTX.string_intern_pos_;) {
+        if (str_eq(data + i, string)) {
+            return data + i;
+        } else {
+            while (data[i] not_eq '\0') {
+                ++i;
+            }
+            ++i;
+        }
+    }
+
+    return nullptr;
+}
+
+
 const char* intern(const char* string)
 {
     const auto len = strlen(string);
@@ -6003,6 +6494,12 @@ const char* intern(const char* string)
         }
     }
 
+    if (L_CTX.string_intern_table_) {
+        if (auto found = intern_table_find(string, len)) {
+            return found;
+        }
+    }
+
     // Ok, no stable pointer to the string exists anywhere, so we'll have to
     // preserve the string contents in intern memory.
 
@@ -6014,24 +6511,14 @@ const char* intern(const char* string)
     if (not L_CTX.string_intern_table_) {
         L_CTX.string_intern_table_ =
             allocate<StringInternTable>("string-intern-table");
+        L_CTX.string_intern_index_ =
+            allocate<StringInternIndex>("string-intern-index");
         info(::format("allocating string intern table (due to symbol %)",
                       string));
     }
 
-    const char* search = (*L_CTX.string_intern_table_)->data_;
-    for (int i = 0; i < L_CTX.string_intern_pos_;) {
-        if (str_eq(search + i, string)) {
-            return search + i;
-        } else {
-            while (search[i] not_eq '\0') {
-                ++i;
-            }
-            ++i;
-        }
-    }
-
-    auto result =
-        (*L_CTX.string_intern_table_)->data_ + L_CTX.string_intern_pos_;
+    const auto offset = L_CTX.string_intern_pos_;
+    auto result = (*L_CTX.string_intern_table_)->data_ + offset;
 
     for (u32 i = 0; i < len; ++i) {
         ((*L_CTX.string_intern_table_)->data_)[L_CTX.string_intern_pos_++] =
@@ -6039,6 +6526,24 @@ const char* intern(const char* string)
     }
     ((*L_CTX.string_intern_table_)->data_)[L_CTX.string_intern_pos_++] = '\0';
 
+    // Keep the index below 3/4 occupancy, so that probe sequences stay short
+    // and always terminate at an empty slot.
+    if (L_CTX.string_intern_indexed_pos_ == offset and
+        L_CTX.string_intern_index_count_ < STRING_INTERN_INDEX_SIZE * 3 / 4) {
+
+        auto& slots = (*L_CTX.string_intern_index_)->slots_;
+        const u32 mask = STRING_INTERN_INDEX_SIZE - 1;
+
+        u32 i = fnv32(string, len) & mask;
+        while (slots[i]) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = offset + 1;
+
+        ++L_CTX.string_intern_index_count_;
+        L_CTX.string_intern_indexed_pos_ = L_CTX.string_intern_pos_;
+    }
+
     return result;
 }
 
@@ -6114,6 +6619,49 @@ NativeInterface::LookupResult __load_builtin(const char* name)
 }
 
 
+Value* load_builtin_fn(Function::CPP_Impl impl,
+                       Optional<Function::Signature> sig)
+{
+    auto& cached =
+        L_CTX.builtin_cache_[((uintptr_t)impl >> 2) % BUILTIN_CACHE_SIZE];
+
+    if (cached->type() == Value::Type::function and
+        cached->function().cpp_impl_ == impl) {
+        ++L_CTX.builtin_cache_hits_;
+        return cached;
+    }
+
+    if (not sig) {
+        // The vm only stores the required argument count in LOAD_BUILTIN
+        // instructions, look up the rest of the signature so that the cached
+        // value matches the one produced by get_var().
+        if (auto name = nameof(impl)) {
+            sig = __load_builtin(name).first;
+        }
+    }
+
+    auto fn = make_function(impl);
+    if (fn->type() not_eq Value::Type::function) {
+        return fn;
+    }
+
+    if (sig) {
+        fn->function().sig_ = *sig;
+    }
+
+    ++L_CTX.builtin_cache_misses_;
+    cached = fn;
+
+    return fn;
+}
+
+
+std::pair<BuiltinCacheHits, BuiltinCacheMisses> builtin_cache_info()
+{
+    return {L_CTX.builtin_cache_hits_, L_CTX.builtin_cache_misses_};
+}
+
+
 Value* get_var(Value* symbol)
 {
     if (symbol->symbol().name()[0] == '$') {
@@ -6172,31 +6720,20 @@ Value* get_var(Value* symbol)
 
     // Next, we want to check to see if any builtin functions exist for our
     // symbol name. By keeping builtins out of the globals tree, we decrease the
-    // lower bound on the interpreter's memory usage. On the other hand, doing
-    // this does put additional pressure on the gc (because the functions need
-    // to be boxed as lisp function each time they're accessed).
+    // lower bound on the interpreter's memory usage. The boxed function values
+    // are cached, so that repeatedly referencing a builtin does not put
+    // pressure on the gc.
     //
     auto builtin = __load_builtin(symbol_name);
     if (builtin.second) {
-        auto fn = lisp::make_function(builtin.second);
-        fn->function().sig_ = builtin.first;
-        return fn;
+        return load_builtin_fn(builtin.second, builtin.first);
     }
 
     // Ok, and as a final step, let's look for any builtin constants, if the
     // system is running with a precomputed constant table.
     if (L_CTX.external_constant_tab_) {
-        u32 i = 0;
-        for (; i < L_CTX.external_constant_tab_size_;) {
-            auto ptr = L_CTX.external_constant_tab_ + i;
-            u8 name_size = ((ConstantTabEntryHeader*)ptr)->field_size_;
-            u8 value_size = ((ConstantTabEntryHeader*)ptr)->value_size_;
-            const char* name = ptr + sizeof(ConstantTabEntryHeader);
-            if (str_eq(name, symbol->symbol().name())) {
-                return dostring(ptr + sizeof(ConstantTabEntryHeader) +
-                                name_size);
-            }
-            i += sizeof(ConstantTabEntryHeader) + name_size + value_size;
+        if (auto v = load_constant(symbol_name)) {
+            return v;
         }
     }
 
@@ -6326,6 +6863,7 @@ void init(Optional<std::pair<const char*, u32>> external_symtab,
     if (external_constant_tab and external_constant_tab->second) {
         L_CTX.external_constant_tab_ = external_constant_tab->first;
         L_CTX.external_constant_tab_size_ = external_constant_tab->second;
+        constant_tab_index_init();
     }
 
     value_pool_init();
@@ -6339,6 +6877,7 @@ void init(Optional<std::pair<const char*, u32>> external_symtab,
     L_CTX.debug_watchpoints_ = L_CTX.nil_;
 
     L_CTX.string_buffer_ = L_CTX.nil_;
+    L_CTX.dostring_cache_ = L_CTX.nil_;
     L_CTX.macros_ = L_CTX.nil_;
 
 #ifdef USE_SYMBOL_CACHE
@@ -6347,6 +6886,10 @@ void init(Optional<std::pair<const char*, u32>> external_symtab,
     }
 #endif
 
+    for (auto& v : L_CTX.builtin_cache_) {
+        v = L_CTX.nil_;
+    }
+
     L_CTX.tree_nullnode_ = L_CONS(get_nil(), L_CONS(get_nil(), get_nil()));
 
     reset_operand_stack();
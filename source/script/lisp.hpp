@@ -813,9 +813,26 @@ void get_env(SymbolCallback callback);
 int toplevel_count();
 
 
-using ValuePoolUsed = u32;
-using ValuePoolFree = u32;
-std::pair<ValuePoolUsed, ValuePoolFree> value_pool_info();
+struct ValuePoolInfo
+{
+    u32 used_;
+    u32 free_;
+
+    // Collector statistics. A pause covers a single call into the collector,
+    // either a full gc() or an incremental step triggered by an allocation.
+    u32 collections_;
+    u32 last_reclaimed_;
+    Microseconds last_pause_;
+    Microseconds max_pause_;
+};
+ValuePoolInfo value_pool_info();
+
+
+// Hit/miss counts for the cache of boxed builtin function values. Each miss
+// allocates a function value.
+using BuiltinCacheHits = u32;
+using BuiltinCacheMisses = u32;
+std::pair<BuiltinCacheHits, BuiltinCacheMisses> builtin_cache_info();
 
 
 Value* get_nil();
@@ -956,6 +973,12 @@ Value* dostring(CharSequence& code,
                 ::Function<4 * sizeof(void*), void(Value&)> on_error);
 Value* dostring(const char* code);
 
+// Like dostring(), but remembers the expressions read from the code, keyed by
+// a hash of its contents. Evaluating the same code again skips the reader and
+// the macroexpander. Only enabled on platforms with memory to spare.
+Value* dostring_cached(CharSequence& code,
+                       ::Function<4 * sizeof(void*), void(Value&)> on_error);
+
 Value* lint_code(CharSequence& code);
 
 
@@ -42,4 +42,10 @@ void lexical_frame_store(Value* kvp);
 NativeInterface::LookupResult __load_builtin(const char* name);
 
 
+// Returns a boxed function value for a builtin, reusing a cached value if
+// possible.
+Value* load_builtin_fn(Function::CPP_Impl impl,
+                       Optional<Function::Signature> sig = {});
+
+
 } // namespace lisp
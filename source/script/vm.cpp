@@ -122,6 +122,13 @@ TOP:
         }
 
 
+        case LexicalVarLoad::op(): {
+            auto inst = read<LexicalVarLoad>(code, pc);
+            push_op(__get_local({inst->frame_, inst->slot_}));
+            break;
+        }
+
+
         case load_var_nonlocal: {
             auto inst = read<LoadVar>(code, pc);
             push_op(get_var_stable(inst->ptr_.get()));
@@ -131,9 +138,7 @@ TOP:
 
         case LoadBuiltin::op(): {
             auto inst = read<LoadBuiltin>(code, pc);
-            auto fn = make_function((Function::CPP_Impl)inst->addr_.get());
-            fn->function().sig_.required_args_ = inst->argc_;
-            push_op(fn);
+            push_op(load_builtin_fn((Function::CPP_Impl)inst->addr_.get()));
             break;
         }
 
@@ -24,30 +24,34 @@ void configure_island(Island& island, lisp::Value* island_desc_lat)
 {
     island.clear_rooms();
 
-    lisp::l_foreach(island_desc_lat, [&](lisp::Value* val) {
-        auto name_symb = lisp::get_list(val, 0);
-        if (name_symb->type() not_eq lisp::Value::Type::symbol) {
-            if (APP.is_developer_mode()) {
-                // TODO: error
+    {
+        Island::BulkEdit bulk_edit(island);
+
+        lisp::l_foreach(island_desc_lat, [&](lisp::Value* val) {
+            auto name_symb = lisp::get_list(val, 0);
+            if (name_symb->type() not_eq lisp::Value::Type::symbol) {
+                if (APP.is_developer_mode()) {
+                    // TODO: error
+                }
+                return;
             }
-            return;
-        }
 
-        const auto len = length(val);
+            const auto len = length(val);
 
 
-        if (len >= 3) {
-            u8 x = lisp::to_integer(lisp::get_list(val, 1));
-            u8 y = lisp::to_integer(lisp::get_list(val, 2));
+            if (len >= 3) {
+                u8 x = lisp::to_integer(lisp::get_list(val, 1));
+                u8 y = lisp::to_integer(lisp::get_list(val, 2));
 
-            if (auto c = load_metaclass(name_symb->symbol().name())) {
-                (*c)->create(&island, RoomCoord{x, y}, false);
-                if (auto room = island.get_room({x, y})) {
-                    room->deserialize(val);
+                if (auto c = load_metaclass(name_symb->symbol().name())) {
+                    (*c)->create(&island, RoomCoord{x, y}, false);
+                    if (auto room = island.get_room({x, y})) {
+                        room->deserialize(val);
+                    }
                 }
             }
-        }
-    });
+        });
+    }
 
     island.repaint();
 
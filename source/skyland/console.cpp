@@ -11,8 +11,11 @@
 
 #include "console.hpp"
 #include "base32.hpp"
+#include "memory/malloc.hpp"
 #include "platform/flash_filesystem.hpp"
+#include "profile.hpp"
 #include "script/lisp.hpp"
+#include "skyland/path.hpp"
 #include "skyland/skyland.hpp"
 
 
@@ -136,6 +139,12 @@ public:
                 "pools annotate         | show memory pool statistics\r\n"
                 "sbr annotate           | show memory buffers in use\r\n"
                 "sbr dump @<buffer id>  | dump memory buffer as hex\r\n"
+                "heap annotate          | show malloc heap statistics\r\n"
+                "heap bench             | benchmark the malloc heap\r\n"
+                "path bench             | benchmark the pathfinder\r\n"
+                "profile on|off         | start or stop the frame profiler\r\n"
+                "profile report         | show recent frame times per zone\r\n"
+                "profile dump <path>    | save recent frames as a chrome trace\r\n"
                 "download <path>        | dump file to console, base32 encoded\r\n"
                 "quit                   | select a different console mode\r\n"
                 "ls <path>              | list files in a directory\r\n";
@@ -155,6 +164,42 @@ public:
                 ++num;
             }
             scratch_buffer_dump_sector(parse_int(num, strlen(num)));
+        } else if (line == "heap annotate" or line == "heap bench") {
+            auto print = [](const char* line) {
+                PLATFORM.remote_console().printline(line);
+                if (PLATFORM.has_slow_cpu()) {
+                    PLATFORM.sleep(1);
+                }
+            };
+            if (line == "heap bench") {
+                malloc_compat::benchmark(print);
+            } else {
+                malloc_compat::heap_diagnostics(print);
+            }
+        } else if (line == "path bench") {
+            find_path_benchmark([](const char* line) {
+                PLATFORM.remote_console().printline(line);
+                if (PLATFORM.has_slow_cpu()) {
+                    PLATFORM.sleep(1);
+                }
+            });
+        } else if (line == "profile on" or line == "profile off") {
+            profile::set_enabled(line == "profile on");
+            PLATFORM.remote_console().printline("ok", "sc> ");
+        } else if (line == "profile report") {
+            profile::report([](const char* line) {
+                PLATFORM.remote_console().printline(line);
+                if (PLATFORM.has_slow_cpu()) {
+                    PLATFORM.sleep(1);
+                }
+            });
+        } else if (parsed.size() == 3 and parsed[0] == "profile" and
+                   parsed[1] == "dump") {
+            if (profile::dump_trace(parsed[2].c_str())) {
+                PLATFORM.remote_console().printline("Complete!", "sc> ");
+            } else {
+                PLATFORM.remote_console().printline("dump failed!", "sc> ");
+            }
         } else if (line == "pools annotate") {
             GenericPool::print_diagnostics();
         } else if (line == "quit") {
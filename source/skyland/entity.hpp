@@ -21,6 +21,7 @@
 #include "memory/segmentedPool.hpp"
 #include "memory/uniquePtr.hpp"
 #include "number/numeric.hpp"
+#include "profile.hpp"
 #include "skyland/types.hpp"
 
 
@@ -79,6 +80,14 @@ public:
     }
 
 
+    // Moves the sprite, without otherwise updating the entity. For drawing
+    // entities at positions interpolated between fixed-step ticks.
+    void set_sprite_position(const Vec2<Fixnum>& position)
+    {
+        sprite_.set_position(position);
+    }
+
+
     const HitBox& hitbox()
     {
         return hitbox_;
@@ -171,8 +180,24 @@ static constexpr const int max_entity_size = 200;
 
 
 
+#if defined(__GBA__) or defined(__NDS__)
 using EntityPools =
     SegmentedPool<max_entity_size, entity_pool_size, 14, entity_pool_align>;
+#else
+// NOTE: On desktop, the entity pool starts out at entity_pool_size, and grows
+// on demand, so that late-game battles don't silently fail to spawn effects.
+// Cells are padded to a cache line, so an entity never straddles more lines
+// than it needs to.
+static constexpr const int entity_segment_size = 30;
+static constexpr const int entity_segment_align = 64;
+using EntityPools =
+    GrowableSegmentedPool<max_entity_size,
+                          entity_segment_size,
+                          (entity_pool_size + entity_segment_size - 1) /
+                              entity_segment_size,
+                          32,
+                          entity_segment_align>;
+#endif
 
 
 
@@ -190,8 +215,19 @@ using EntityNode = BinaryNode<EntityRef<Entity>>;
 
 
 
+#if defined(__GBA__) or defined(__NDS__)
 template <u32 Capacity>
 using EntityNodePool = Pool<sizeof(EntityNode), Capacity, alignof(Entity)>;
+#else
+// The list node pool needs to grow alongside the entity pool, otherwise, lists
+// would drop entities once we exceed entity_pool_size.
+template <u32 Capacity>
+using EntityNodePool = GrowableSegmentedPool<sizeof(EntityNode),
+                                             Capacity,
+                                             1,
+                                             8,
+                                             alignof(Entity)>;
+#endif
 
 
 
@@ -228,6 +264,8 @@ using SharedEntityList =
 
 template <typename T> void update_entities(Time dt, EntityList<T>& lat)
 {
+    PROFILE_ZONE("update_entities");
+
     for (auto it = lat.begin(); it not_eq lat.end();) {
         if (not(*it)->alive()) {
             it = lat.erase(it);
@@ -22,6 +22,7 @@
 #include "number/random.hpp"
 #include "platform/flash_filesystem.hpp"
 #include "preload.hpp"
+#include "profile.hpp"
 #include "roomPool.hpp"
 #include "room_metatable.hpp"
 #include "rooms/chaosCore.hpp"
@@ -805,6 +806,8 @@ lisp::Value* wrap_island(Island* isle);
 
 void Island::update(Time dt)
 {
+    PROFILE_ZONE("Island::update");
+
     update_simple(dt);
 
     if (should_recompute_deflector_shields_) {
@@ -1361,6 +1364,8 @@ HitBox Island::hitbox() const
 
 void Island::test_collision(Entity& entity)
 {
+    PROFILE_ZONE("Island::test_collision");
+
     if (phase_ == 1) {
         return;
     }
@@ -1675,6 +1680,80 @@ void Island::plot_rooms(u8 matrix[16][16]) const
 }
 
 
+void Island::on_room_added(Room* room, bool do_repaint)
+{
+    if (bulk_edit_depth_) {
+        // NOTE: a full recalculate_power_usage() walks every room, which adds
+        // up to quadratic work while generating a level. Callers may still
+        // query the power balance mid-edit, so keep the totals current by
+        // accumulating the new room, and recalculate exactly on commit.
+        auto power = room->power_usage();
+        if (power < 0) {
+            power_supply_ += -power;
+        } else {
+            power_drain_ += power;
+        }
+        bulk_repaint_pending_ = bulk_repaint_pending_ or do_repaint;
+        bulk_last_added_ = room->position();
+        ++bulk_edit_stats_.rooms_added_;
+        return;
+    }
+
+    if (do_repaint) {
+        repaint();
+    }
+    recalculate_power_usage();
+    on_layout_changed(room->position());
+    schedule_recompute_deflector_shields();
+}
+
+
+
+void Island::commit_bulk_edit()
+{
+    if (bulk_repaint_pending_) {
+        repaint();
+        bulk_repaint_pending_ = false;
+    }
+
+    if (bulk_last_added_) {
+        recalculate_power_usage();
+        on_layout_changed(*bulk_last_added_);
+        schedule_recompute_deflector_shields();
+        bulk_last_added_.reset();
+    }
+}
+
+
+
+Island::BulkEdit::BulkEdit(Island& island)
+    : island_(island), start_(PLATFORM.delta_clock().sample())
+{
+    if (island_.bulk_edit_depth_ == 0) {
+        island_.bulk_edit_stats_.rooms_added_ = 0;
+    }
+    ++island_.bulk_edit_depth_;
+}
+
+
+
+Island::BulkEdit::~BulkEdit()
+{
+    if (--island_.bulk_edit_depth_ == 0) {
+        island_.commit_bulk_edit();
+
+        auto& stats = island_.bulk_edit_stats_;
+        stats.last_duration_ = Platform::DeltaClock::duration(
+            start_, PLATFORM.delta_clock().sample());
+
+        info(format("bulk edit: % rooms in %us",
+                    stats.rooms_added_,
+                    stats.last_duration_));
+    }
+}
+
+
+
 void Island::recalculate_power_usage()
 {
     power_supply_ = 0;
@@ -1981,6 +2060,8 @@ void Island::repaint_partial()
 
 void Island::repaint()
 {
+    PROFILE_ZONE("Island::repaint");
+
     if (hidden_) {
         return;
     }
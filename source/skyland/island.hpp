@@ -43,13 +43,11 @@ public:
         if (rooms().full()) {
             return false;
         }
+        Room* room = insert.get();
         auto result = rooms_.insert_room(std::move(insert));
-        if (do_repaint) {
-            repaint();
+        if (result) {
+            on_room_added(room, do_repaint);
         }
-        recalculate_power_usage();
-        on_layout_changed(insert->position());
-        schedule_recompute_deflector_shields();
         return result;
     }
 
@@ -62,13 +60,9 @@ public:
         }
         if (auto room = room_pool::alloc<T>(
                 this, position, std::forward<Args>(args)...)) {
+            Room* inserted = room.get();
             if (rooms_.insert_room({room.release(), room_pool::deleter})) {
-                if (do_repaint) {
-                    repaint();
-                }
-                recalculate_power_usage();
-                on_layout_changed(position);
-                schedule_recompute_deflector_shields();
+                on_room_added(inserted, do_repaint);
                 return true;
             }
         }
@@ -77,6 +71,38 @@ public:
     }
 
 
+    // While a BulkEdit is alive, add_room() defers the island repaint, the
+    // layout bookkeeping, and the deflector shield recomputation, and only
+    // adjusts the power totals incrementally. The deferred work runs once, when
+    // the outermost BulkEdit goes out of scope. Intended for level loading and
+    // procedural generation, which insert dozens of rooms back-to-back.
+    class BulkEdit
+    {
+    public:
+        BulkEdit(Island& island);
+        ~BulkEdit();
+
+        BulkEdit(const BulkEdit&) = delete;
+
+    private:
+        Island& island_;
+        Platform::DeltaClock::TimePoint start_;
+    };
+
+
+    struct BulkEditStats
+    {
+        u32 rooms_added_ = 0;
+        Microseconds last_duration_ = 0;
+    };
+
+
+    const BulkEditStats& bulk_edit_stats() const
+    {
+        return bulk_edit_stats_;
+    }
+
+
     void move_room(const RoomCoord& from, const RoomCoord& to);
 
 
@@ -432,6 +458,12 @@ public:
 
 
 private:
+    void on_room_added(Room* room, bool do_repaint);
+
+
+    void commit_bulk_edit();
+
+
     void recompute_deflector_shields();
 
 
@@ -494,6 +526,10 @@ private:
 
     BlockChecksum checksum_ = 0;
 
+    BulkEditStats bulk_edit_stats_;
+    Optional<RoomCoord> bulk_last_added_;
+    u8 bulk_edit_depth_ = 0;
+
     u8 flag_anim_index_;
     u8 core_count_ = 0;
     u8 min_y_ = 0;
@@ -523,6 +559,7 @@ private:
     bool hidden_ : 1;
     bool show_powerdown_opts_ : 1 = false;
     bool should_recompute_deflector_shields_ : 1 = false;
+    bool bulk_repaint_pending_ : 1 = false;
     bool dark_smoke_ : 1 = false;
     bool mountain_terrain_ : 1 = false;
     u8 phase_ : 1 = 0;
@@ -21,6 +21,244 @@ namespace skyland
 
 
 
+namespace
+{
+
+
+
+// Vertices are identified by (x * 16 + y). The final row of the grid never
+// contains vertices, so no vertex index collides with the none marker.
+using VertexId = u8;
+static constexpr VertexId vertex_none = 0xff;
+
+
+
+VertexId vertex_id(const RoomCoord& c)
+{
+    return c.x * 16 + c.y;
+}
+
+
+
+RoomCoord vertex_coord(VertexId v)
+{
+    return {(u8)(v / 16), (u8)(v % 16)};
+}
+
+
+
+// A binary min-heap of vertices, ordered by distance, with an index of each
+// vertex's position in the heap, so that we can decrease a vertex's key in
+// place rather than pushing duplicate entries.
+class VertexQueue
+{
+public:
+    VertexQueue(const u16* dist) : dist_(dist)
+    {
+        for (auto& p : pos_) {
+            p = vertex_none;
+        }
+    }
+
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+
+    // Call after decreasing the distance of a vertex.
+    void update(VertexId v)
+    {
+        if (pos_[v] == vertex_none) {
+            heap_[size_] = v;
+            pos_[v] = size_;
+            ++size_;
+        }
+        sift_up(pos_[v]);
+    }
+
+
+    VertexId pop()
+    {
+        const auto top = heap_[0];
+        pos_[top] = vertex_none;
+
+        if (--size_) {
+            heap_[0] = heap_[size_];
+            pos_[heap_[0]] = 0;
+            sift_down(0);
+        }
+
+        return top;
+    }
+
+
+private:
+    bool less(int i, int j) const
+    {
+        return dist_[heap_[i]] < dist_[heap_[j]];
+    }
+
+
+    void swap(int i, int j)
+    {
+        std::swap(heap_[i], heap_[j]);
+        pos_[heap_[i]] = i;
+        pos_[heap_[j]] = j;
+    }
+
+
+    void sift_up(int i)
+    {
+        while (i > 0) {
+            const int parent = (i - 1) / 2;
+            if (not less(i, parent)) {
+                break;
+            }
+            swap(i, parent);
+            i = parent;
+        }
+    }
+
+
+    void sift_down(int i)
+    {
+        while (true) {
+            const int l = i * 2 + 1;
+            const int r = l + 1;
+            int min = i;
+            if (l < size_ and less(l, min)) {
+                min = l;
+            }
+            if (r < size_ and less(r, min)) {
+                min = r;
+            }
+            if (min == i) {
+                break;
+            }
+            swap(i, min);
+            i = min;
+        }
+    }
+
+
+    const u16* dist_;
+    VertexId heap_[256];
+    VertexId pos_[256];
+    int size_ = 0;
+};
+
+
+
+using PortalBuffer = Buffer<RoomCoord, 32>;
+
+
+
+// NOTE: Only consider vertices starting at the minimum y for which rooms can be
+// built. Do not include the 16th (final) row, because it just contains
+// terrain.
+bool is_vertex(const bool matrix[16][16], const RoomCoord& c)
+{
+    return c.x < 16 and c.y >= construction_zone_min_y and c.y < 15 and
+           matrix[c.x][c.y];
+}
+
+
+
+Optional<Path> find_path(const bool matrix[16][16],
+                         const PortalBuffer& portals,
+                         const RoomCoord& start,
+                         const RoomCoord& end)
+{
+    auto is_vertex = [&](const RoomCoord& c) {
+        return skyland::is_vertex(matrix, c);
+    };
+
+    if (not is_vertex(start)) {
+        error("missing startv");
+        return {};
+    }
+
+    if (not is_vertex(end)) {
+        return {};
+    }
+
+    u16 dist[256];
+    for (auto& d : dist) {
+        d = std::numeric_limits<u16>::max();
+    }
+
+    VertexId prev[256];
+
+    VertexQueue queue(dist);
+
+    auto relax = [&](VertexId from, const RoomCoord& to_coord, int weight) {
+        if (not is_vertex(to_coord)) {
+            return;
+        }
+        const auto to = vertex_id(to_coord);
+        const int alt = dist[from] + weight;
+        if (alt < dist[to]) {
+            dist[to] = alt;
+            prev[to] = from;
+            queue.update(to);
+        }
+    };
+
+    const auto start_v = vertex_id(start);
+    dist[start_v] = 0;
+    prev[start_v] = vertex_none;
+    queue.update(start_v);
+
+    while (not queue.empty()) {
+        const auto v = queue.pop();
+        const auto c = vertex_coord(v);
+
+        if (c == end) {
+            auto path_mem = allocate_small<PathBuffer>("path-buffer");
+            if (not path_mem) {
+                return {};
+            }
+
+            auto current_v = v;
+            while (current_v not_eq vertex_none) {
+                path_mem->push_back(vertex_coord(current_v));
+                current_v = prev[current_v];
+            }
+            return path_mem;
+        }
+
+        if (c.x > 0) {
+            relax(v, {u8(c.x - 1), c.y}, 1);
+        }
+        if (c.x < 15) {
+            relax(v, {u8(c.x + 1), c.y}, 1);
+        }
+        if (c.y > 0) {
+            relax(v, {c.x, u8(c.y - 1)}, 1);
+        }
+        if (c.y < 15) {
+            relax(v, {c.x, u8(c.y + 1)}, 1);
+        }
+
+        for (auto& p : portals) {
+            if (p == c) {
+                for (auto& o : portals) {
+                    if (o not_eq c) {
+                        relax(v, o, manhattan_length(c, o));
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    return {};
+}
+
+
+
 struct PathVertexData
 {
     PathVertexData* prev_ = nullptr;
@@ -30,10 +268,12 @@ struct PathVertexData
 
 
 
-Optional<Path> find_path(Island* island,
-                         Character* for_character,
-                         const RoomCoord& start,
-                         const RoomCoord& end)
+// The pathfinder that find_path() replaced, which re-sorts every vertex after
+// each expansion. Kept as a reference for find_path_benchmark().
+Optional<Path> find_path_reference(const bool matrix[16][16],
+                                   const PortalBuffer& portals,
+                                   const RoomCoord& start,
+                                   const RoomCoord& end)
 {
     BulkAllocator<2> vertex_memory_;
 
@@ -41,16 +281,9 @@ Optional<Path> find_path(Island* island,
     VertexBuffer priority_q(VertexBuffer::SkipZeroFill{});
     PathVertexData* vertex_mat[16][16] = {};
 
-
-
-    bool matrix[16][16];
-    island->plot_walkable_zones(matrix, for_character);
-
     PathVertexData* start_v = nullptr;
 
     for (u8 x = 0; x < 16; ++x) {
-        // NOTE: start at the minimum y for which rooms can be built. Do not
-        // include the 16th (final) row, because it just contains terrain.
         for (u8 y = construction_zone_min_y; y < 15; ++y) {
             if (matrix[x][y]) {
                 if (auto obj = vertex_memory_.alloc<PathVertexData>()) {
@@ -70,35 +303,23 @@ Optional<Path> find_path(Island* island,
     }
 
     if (not start_v) {
-        error("missing startv");
         return {};
     }
 
     auto neighbors = [&](PathVertexData* data) {
         Buffer<PathVertexData*, 4> result;
-        if (data->coord_.x > 0) {
-            auto n = vertex_mat[data->coord_.x - 1][data->coord_.y];
-            if (n) {
-                result.push_unsafe(n);
-            }
+        const auto c = data->coord_;
+        if (c.x > 0 and vertex_mat[c.x - 1][c.y]) {
+            result.push_unsafe(vertex_mat[c.x - 1][c.y]);
         }
-        if (data->coord_.x < 15) {
-            auto n = vertex_mat[data->coord_.x + 1][data->coord_.y];
-            if (n) {
-                result.push_unsafe(n);
-            }
+        if (c.x < 15 and vertex_mat[c.x + 1][c.y]) {
+            result.push_unsafe(vertex_mat[c.x + 1][c.y]);
         }
-        if (data->coord_.y > 0) {
-            auto n = vertex_mat[data->coord_.x][data->coord_.y - 1];
-            if (n) {
-                result.push_unsafe(n);
-            }
+        if (c.y > 0 and vertex_mat[c.x][c.y - 1]) {
+            result.push_unsafe(vertex_mat[c.x][c.y - 1]);
         }
-        if (data->coord_.y < 15) {
-            auto n = vertex_mat[data->coord_.x][data->coord_.y + 1];
-            if (n) {
-                result.push_unsafe(n);
-            }
+        if (c.y < 15 and vertex_mat[c.x][c.y + 1]) {
+            result.push_unsafe(vertex_mat[c.x][c.y + 1]);
         }
         return result;
     };
@@ -111,59 +332,220 @@ Optional<Path> find_path(Island* island,
 
     sort_q();
 
-    while (true) {
-        if (not priority_q.empty()) {
-            auto min = priority_q.back();
-            if (min->dist_ == std::numeric_limits<u16>::max()) {
+    while (not priority_q.empty()) {
+        auto min = priority_q.back();
+        if (min->dist_ == std::numeric_limits<u16>::max()) {
+            return {};
+        }
+        if (min->coord_ == end) {
+            auto path_mem = allocate_small<PathBuffer>("path-buffer");
+            if (not path_mem) {
                 return {};
             }
-            if (min->coord_ == end) {
-                auto path_mem = allocate_small<PathBuffer>("path-buffer");
-                if (not path_mem) {
-                    return {};
-                }
 
-                auto current_v = priority_q.back();
-                while (current_v) {
-                    path_mem->push_back(current_v->coord_);
-                    current_v = current_v->prev_;
-                }
-                return path_mem;
+            auto current_v = priority_q.back();
+            while (current_v) {
+                path_mem->push_back(current_v->coord_);
+                current_v = current_v->prev_;
             }
-            priority_q.pop_back();
+            return path_mem;
+        }
+        priority_q.pop_back();
 
-            for (auto& neighbor : neighbors(min)) {
-                auto alt = min->dist_ +
-                           manhattan_length(min->coord_, neighbor->coord_);
-                if (alt < neighbor->dist_) {
-                    neighbor->dist_ = alt;
-                    neighbor->prev_ = min;
-                }
+        for (auto& neighbor : neighbors(min)) {
+            auto alt =
+                min->dist_ + manhattan_length(min->coord_, neighbor->coord_);
+            if (alt < neighbor->dist_) {
+                neighbor->dist_ = alt;
+                neighbor->prev_ = min;
             }
-            if (auto room = island->get_room(min->coord_)) {
-                if (room->cast<Portal>()) {
-                    for (auto& o : island->rooms()) {
-                        if (o.get() not_eq room and o->cast<Portal>()) {
-                            auto alt =
-                                min->dist_ +
-                                manhattan_length(min->coord_, o->position());
-                            if (auto n = vertex_mat[o->position().x]
-                                                   [o->position().y]) {
-                                if (alt < n->dist_) {
-                                    n->dist_ = alt;
-                                    n->prev_ = min;
-                                }
-                            }
+        }
+
+        for (auto& p : portals) {
+            if (p == min->coord_) {
+                for (auto& o : portals) {
+                    if (o == min->coord_) {
+                        continue;
+                    }
+                    auto alt = min->dist_ + manhattan_length(min->coord_, o);
+                    if (auto n = vertex_mat[o.x][o.y]) {
+                        if (alt < n->dist_) {
+                            n->dist_ = alt;
+                            n->prev_ = min;
                         }
                     }
                 }
+                break;
             }
-            sort_q();
+        }
 
-        } else {
-            return {};
+        sort_q();
+    }
+
+    return {};
+}
+
+
+
+// Sums the edge weights along a path, or returns -1 if the path takes a step
+// that isn't an edge in the graph.
+int path_cost(const bool matrix[16][16],
+              const PortalBuffer& portals,
+              const PathBuffer& path)
+{
+    auto is_portal = [&](const RoomCoord& c) {
+        for (auto& p : portals) {
+            if (p == c) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    int cost = 0;
+    for (u32 i = 0; i < path.size(); ++i) {
+        if (not is_vertex(matrix, path[i])) {
+            return -1;
+        }
+        if (i == 0) {
+            continue;
+        }
+        const int len = manhattan_length(path[i - 1], path[i]);
+        if (len not_eq 1 and
+            not(is_portal(path[i - 1]) and is_portal(path[i]))) {
+            return -1;
         }
+        cost += len;
     }
+
+    return cost;
+}
+
+
+
+} // namespace
+
+
+
+Optional<Path> find_path(Island* island,
+                         Character* for_character,
+                         const RoomCoord& start,
+                         const RoomCoord& end)
+{
+    bool matrix[16][16];
+    island->plot_walkable_zones(matrix, for_character);
+
+    // Portals are the only edges in the graph that do not connect adjacent
+    // tiles. Collect them up front, rather than scanning the island's rooms
+    // each time that we expand a vertex.
+    PortalBuffer portals;
+    for (auto& room : island->rooms()) {
+        if (room->cast<Portal>() and is_vertex(matrix, room->position())) {
+            if (not portals.push_back(room->position())) {
+                error("too many portals for pathfinder");
+                break;
+            }
+        }
+    }
+
+    return find_path(matrix, portals, start, end);
+}
+
+
+
+void find_path_benchmark(Function<4 * sizeof(void*), void(const char*)> cb)
+{
+    static const int layout_count = 32;
+    static const int query_count = 16;
+
+    u32 state = 2463534242u;
+    auto next = [&state] {
+        // xorshift32, so that each run replays the same workload.
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    Microseconds fast_time = 0;
+    Microseconds reference_time = 0;
+    int found = 0;
+    int mismatches = 0;
+
+    for (int i = 0; i < layout_count; ++i) {
+        // Something like an island: floors of varying lengths, stacked in
+        // rows, joined by the occasional ladder, with a few portals.
+        bool matrix[16][16] = {};
+        const int width = 8 + next() % 9;
+        for (int y = construction_zone_min_y + 1; y < 15; y += 2) {
+            const int from = next() % 4;
+            const int to = width - next() % 4;
+            for (int x = from; x < to; ++x) {
+                matrix[x][y] = true;
+            }
+            if (y + 2 < 15) {
+                const int ladder = from + next() % std::max(1, to - from);
+                matrix[ladder][y + 1] = true;
+            }
+        }
+
+        PathBuffer vertices;
+        for (u8 x = 0; x < 16; ++x) {
+            for (u8 y = 0; y < 16; ++y) {
+                if (is_vertex(matrix, {x, y})) {
+                    vertices.push_back({x, y});
+                }
+            }
+        }
+
+        if (vertices.empty()) {
+            continue;
+        }
+
+        PortalBuffer portals;
+        const int portal_count = next() % 5;
+        for (int p = 0; p < portal_count; ++p) {
+            portals.push_back(vertices[next() % vertices.size()]);
+        }
+
+        for (int q = 0; q < query_count; ++q) {
+            const auto start = vertices[next() % vertices.size()];
+            const auto end = vertices[next() % vertices.size()];
+
+            auto t1 = PLATFORM.delta_clock().sample();
+            auto fast = find_path(matrix, portals, start, end);
+            auto t2 = PLATFORM.delta_clock().sample();
+            auto reference = find_path_reference(matrix, portals, start, end);
+            auto t3 = PLATFORM.delta_clock().sample();
+
+            fast_time += Platform::DeltaClock::duration(t1, t2);
+            reference_time += Platform::DeltaClock::duration(t2, t3);
+
+            if (bool(fast) not_eq bool(reference)) {
+                ++mismatches;
+                continue;
+            }
+
+            if (fast) {
+                ++found;
+                const auto cost = path_cost(matrix, portals, **fast);
+                if (cost == -1 or
+                    cost not_eq path_cost(matrix, portals, **reference) or
+                    (*fast)->back() not_eq start or
+                    (**fast)[0] not_eq end) {
+                    ++mismatches;
+                }
+            }
+        }
+    }
+
+    const int queries = layout_count * query_count;
+
+    cb(format("path bench: % queries, % paths found", queries, found)
+           .c_str());
+    cb(format("  find_path: %us, reference: %us", fast_time, reference_time)
+           .c_str());
+    cb(format("  mismatches: %", mismatches).c_str());
 }
 
 
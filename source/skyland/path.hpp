@@ -15,6 +15,7 @@
 
 #include "allocator.hpp"
 #include "coord.hpp"
+#include "function.hpp"
 
 
 
@@ -42,4 +43,10 @@ Optional<Path> find_path(Island* island,
 
 
 
+// Times find_path() over generated 16x16 layouts with portals, and checks its
+// paths against the sort-based pathfinder that it replaced.
+void find_path_benchmark(Function<4 * sizeof(void*), void(const char*)> cb);
+
+
+
 } // namespace skyland
@@ -11,6 +11,7 @@
 
 #include "enemyAI.hpp"
 #include "number/random.hpp"
+#include "profile.hpp"
 #include "skyland/entity/drones/droneMeta.hpp"
 #include "skyland/entity/projectile/missile.hpp"
 #include "skyland/latency.hpp"
@@ -63,6 +64,8 @@ namespace skyland
 
 void EnemyAI::update(Time delta)
 {
+    PROFILE_ZONE("EnemyAI::update");
+
     if (APP.player_island().is_destroyed()) {
         return;
     }
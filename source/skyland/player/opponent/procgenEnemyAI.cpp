@@ -11,6 +11,7 @@
 
 #include "procgenEnemyAI.hpp"
 #include "allocator.hpp"
+#include "profile.hpp"
 #include "skyland/entity/birds/genericBird.hpp"
 #include "skyland/network.hpp"
 #include "skyland/preload.hpp"
@@ -51,6 +52,8 @@ ProcgenEnemyAI::ProcgenEnemyAI(rng::LinearGenerator seed, u8 difficulty)
 
 void ProcgenEnemyAI::update(Time delta)
 {
+    PROFILE_ZONE("ProcgenEnemyAI::update");
+
     if (not APP.opponent_island()) {
         generate_level();
 
@@ -179,48 +182,54 @@ void ProcgenEnemyAI::generate_level()
     APP.create_opponent_island(levelgen_size_.x);
     APP.opponent_island()->show_flag(true);
 
-    generate_power_sources();
+    {
+        // NOTE: we insert a lot of rooms, one at a time, below. Repaint the
+        // island and refresh its layout once, after everything's been placed.
+        Island::BulkEdit bulk_edit(*APP.opponent_island());
 
-    if (levelgen_enemy_count_ > 2 or rng::choice<2>(rng_source_)) {
-        generate_stairwells();
-    }
+        generate_power_sources();
 
-    generate_secondary_rooms();
-    generate_characters();
-    generate_radiators();
-
-    generate_hull();
-
-    int weapon_limit = 0;
-    if (levelgen_enemy_count_ < 1) {
-        weapon_limit = 1;
-    } else if (levelgen_enemy_count_ < 2) {
-        weapon_limit = 2;
-    } else if (core_count_ < 2) {
-        weapon_limit = 3;
-    } else if (core_count_ < 3) {
-        weapon_limit = 5;
-    } else if (core_count_ < 4) {
-        weapon_limit = 7;
-    } else {
-        weapon_limit = 11;
-    }
-    generate_weapons(weapon_limit);
+        if (levelgen_enemy_count_ > 2 or rng::choice<2>(rng_source_)) {
+            generate_stairwells();
+        }
 
-    if (core_count_ >= 2) {
-        generate_forcefields();
-        generate_missile_defenses();
-    }
+        generate_secondary_rooms();
+        generate_characters();
+        generate_radiators();
 
-    generate_foundation();
+        generate_hull();
 
-    cleanup_unused_terrain();
+        int weapon_limit = 0;
+        if (levelgen_enemy_count_ < 1) {
+            weapon_limit = 1;
+        } else if (levelgen_enemy_count_ < 2) {
+            weapon_limit = 2;
+        } else if (core_count_ < 2) {
+            weapon_limit = 3;
+        } else if (core_count_ < 3) {
+            weapon_limit = 5;
+        } else if (core_count_ < 4) {
+            weapon_limit = 7;
+        } else {
+            weapon_limit = 11;
+        }
+        generate_weapons(weapon_limit);
+
+        if (core_count_ >= 2) {
+            generate_forcefields();
+            generate_missile_defenses();
+        }
 
-    generate_walls_behind_weapons();
+        generate_foundation();
 
-    generate_decorations();
+        cleanup_unused_terrain();
 
-    generate_foundation();
+        generate_walls_behind_weapons();
+
+        generate_decorations();
+
+        generate_foundation();
+    }
 
 
     if (not script_preload_active()) {
@@ -75,9 +75,16 @@ public:
 
     typename Rooms::Iterator erase(typename Rooms::Iterator it)
     {
-        auto result = rooms_.erase(it);
-        reindex(false);
-        return result;
+        if (*it) {
+            unstamp(it->get());
+            return rooms_.erase(it);
+        } else {
+            // The caller moved the room out of the table before erasing the
+            // slot, so we don't know which cells it occupied.
+            auto result = rooms_.erase(it);
+            reindex(false);
+            return result;
+        }
     }
 
 
@@ -95,9 +102,33 @@ public:
 
     bool insert_room(RoomPtr<Room> room)
     {
-        bool result = rooms_.push_back(std::move(room));
-        reindex(true);
-        return result;
+        if (not rooms_.push_back(std::move(room))) {
+            return false;
+        }
+
+        // Keep the rooms sorted by x position, as reindex() would. Binary
+        // search for the insertion point, and rotate the new room into place.
+        auto inserted = rooms_.end() - 1;
+        const auto x = (*inserted)->position().x;
+        auto pos = std::upper_bound(
+            rooms_.begin(), inserted, x, [](auto x, auto& room) {
+                return x < room->position().x;
+            });
+        std::rotate(pos, inserted, rooms_.end());
+
+        // NOTE: A full reindex drops hidden rooms from the matrix, and some
+        // code depends on that. Room::convert_to_plundered(), for example,
+        // hides a room and then inserts new rooms overlapping with it, which
+        // may not cover all of its cells.
+        for (auto& r : rooms_) {
+            if (r->hidden()) {
+                unstamp(r.get());
+            }
+        }
+
+        stamp(pos->get());
+
+        return true;
     }
 
 
@@ -115,14 +146,13 @@ public:
     {
         for (auto it = rooms_.begin(); it not_eq rooms_.end();) {
             if (it->get() == room) {
+                unstamp(room);
                 it = rooms_.erase(it);
                 break;
             } else {
                 ++it;
             }
         }
-
-        reindex(false);
     }
 
 
@@ -151,24 +181,46 @@ public:
         }
 
         for (auto& room : rooms_) {
-            if (room->hidden()) {
-                continue;
+            stamp(room.get());
+        }
+    }
+
+private:
+    // Writes the room into the cells of the matrix that it occupies.
+    void stamp(Room* room)
+    {
+        if (room->hidden()) {
+            return;
+        }
+        for (int x = room->position().x;
+             x < room->position().x + room->size().x;
+             ++x) {
+            for (int y = room->position().y;
+                 y < room->position().y + room->size().y;
+                 ++y) {
+                if (x < 16 and y < 16) {
+                    data_->data_[x][y] = room;
+                }
             }
-            for (int x = room->position().x;
-                 x < room->position().x + room->size().x;
-                 ++x) {
-                for (int y = room->position().y;
-                     y < room->position().y + room->size().y;
-                     ++y) {
-                    if (x < 16 and y < 16) {
-                        data_->data_[x][y] = room.get();
-                    }
+        }
+    }
+
+
+    void unstamp(Room* room)
+    {
+        for (int x = room->position().x;
+             x < room->position().x + room->size().x;
+             ++x) {
+            for (int y = room->position().y;
+                 y < room->position().y + room->size().y;
+                 ++y) {
+                if (x < 16 and y < 16 and data_->data_[x][y] == room) {
+                    data_->data_[x][y] = nullptr;
                 }
             }
         }
     }
 
-private:
     RoomMatrix* data_;
     Rooms rooms_;
 };
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2023 Evan Bowman
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/. */
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "benchmarkScene.hpp"
+#include "bench.hpp"
+#include "fadeInScene.hpp"
+#include "number/random.hpp"
+#include "skyland/player/playerP1.hpp"
+#include "skyland/scene_pool.hpp"
+#include "skyland/skyland.hpp"
+#include "skyland/timeStreamEvent.hpp"
+
+
+
+namespace skyland
+{
+
+
+
+void prep_level();
+
+
+
+void BenchmarkScene::enter(Scene& prev)
+{
+    // NOTE: Same cleanup as SelectTutorialScene, which the tutorial scripts
+    // expect when they (re)start a level.
+    APP.set_coins(0);
+
+    APP.player_island().projectiles().clear();
+
+    PLATFORM.fill_overlay(0);
+
+    APP.stat_timer().reset(0);
+
+    APP.effects().clear();
+
+    for (u8 x = 0; x < 16; ++x) {
+        for (u8 y = 0; y < 16; ++y) {
+            APP.player_island().fire_extinguish({x, y});
+        }
+    }
+
+    APP.swap_player<PlayerP1>();
+
+    APP.game_mode() = App::GameMode::tutorial;
+}
+
+
+
+ScenePtr BenchmarkScene::update(Time delta)
+{
+    auto arg = PLATFORM.get_extensions().startup_opt_arg;
+
+    const char* script = arg ? arg("--bench") : nullptr;
+    if (not script) {
+        PLATFORM.fatal("--bench expects a script path");
+    }
+
+    if (not state_bit_load(StateBit::benchmark)) {
+        int minutes = 5;
+        if (auto m = arg("--bench-minutes")) {
+            minutes = parse_int(m, strlen(m));
+        }
+
+        info(format("bench: running % for % simulated minutes...",
+                    script,
+                    minutes));
+
+        state_bit_store(StateBit::benchmark, true);
+        bench::begin(minutes);
+    }
+
+    APP.invoke_script("/scripts/reset_hooks.lisp");
+    APP.invoke_script(script);
+
+    prep_level();
+    APP.player_island().repaint();
+    APP.player_island().render_exterior();
+
+    rng::critical_state = 42;
+
+    APP.time_stream().enable_pushes(true);
+    APP.time_stream().clear();
+
+    time_stream::event::Initial e;
+    APP.push_time_stream(e);
+
+    return make_scene<FadeInScene>();
+}
+
+
+
+} // namespace skyland
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2023 Evan Bowman
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/. */
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+
+#include "skyland/scene.hpp"
+
+
+
+namespace skyland
+{
+
+
+
+// Loads the level script passed to --bench, and starts the level. The script
+// should set up both islands, and drive the player with (autopilot ...), like
+// the tutorials do. When the level ends, we land back here and replay it, until
+// the benchmark has simulated enough time.
+class BenchmarkScene : public Scene
+{
+public:
+    void enter(Scene& prev) override;
+
+    ScenePtr update(Time delta) override;
+};
+
+
+
+} // namespace skyland
@@ -17,6 +17,7 @@
 #include "platform/flash_filesystem.hpp"
 #include "script/lisp.hpp"
 #include "skyland/latency.hpp"
+#include "skyland/scene/benchmarkScene.hpp"
 #include "skyland/player/coOpTeam.hpp"
 #include "skyland/scene/desktopOS.hpp"
 #include "skyland/scene/introCreditsScene.hpp"
@@ -336,7 +337,7 @@ public:
                 PLATFORM.set_tile(Layer::overlay, i, 10, 0);
             }
             Text::print(
-                format("Lisp: [%]", lisp::value_pool_info().first).c_str(),
+                format("Lisp: [%]", lisp::value_pool_info().used_).c_str(),
                 {16, 10},
                 fc);
         }
@@ -467,6 +468,11 @@ public:
                 TitleScreenScene::run_init_scripts(false);
                 return make_scene<RegressionModule>();
             }
+            if (match("--bench")) {
+                setup_pools();
+                TitleScreenScene::run_init_scripts(false);
+                return make_scene<BenchmarkScene>();
+            }
         }
 
         if (not flash_filesystem::file_exists(lang_file) or clean_boot_) {
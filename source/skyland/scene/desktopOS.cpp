@@ -621,17 +621,12 @@ public:
                         {1, 5});
             auto lisp_mem = lisp::value_pool_info();
             Text::print(format("lisp:[%/%]",
-                               lisp_mem.first,
-                               lisp_mem.first + lisp_mem.second)
+                               lisp_mem.used_,
+                               lisp_mem.used_ + lisp_mem.free_)
                             .c_str(),
                         {1, 7});
-            int ent_used = 0;
-            int ent_total = 0;
-            for (auto& pl : globals().entity_pools_.pools()) {
-                ent_used +=
-                    pl->pooled_element_count() - pl->pooled_element_remaining();
-                ent_total += pl->pooled_element_count();
-            }
+            int ent_used = globals().entity_pools_.elements_used();
+            int ent_total = globals().entity_pools_.elements_total();
             Text::print(format("entity:[%/%]", ent_used, ent_total).c_str(),
                         {13, 5});
 
@@ -10,6 +10,7 @@
 
 
 #include "fadeOutScene.hpp"
+#include "benchmarkScene.hpp"
 #include "debriefScene.hpp"
 #include "levelExitScene.hpp"
 #include "selectChallengeScene.hpp"
@@ -99,6 +100,10 @@ ScenePtr FadeOutScene::update(Time delta)
             return make_scene<LevelExitScene<RegressionModule>>();
         }
 
+        if (state_bit_load(StateBit::benchmark)) {
+            return make_scene<LevelExitScene<BenchmarkScene>>();
+        }
+
         switch (APP.game_mode()) {
         case App::GameMode::tutorial:
             return make_scene<LevelExitScene<SelectTutorialScene>>();
@@ -2065,9 +2065,11 @@ ScenePtr RewindScene::update(Time)
         for (auto& room : APP.player_island().rooms()) {
             room->set_hidden(false);
         }
+        APP.player_island().rooms().reindex(true);
         for (auto& room : APP.opponent_island()->rooms()) {
             room->set_hidden(false);
         }
+        APP.opponent_island()->rooms().reindex(true);
     }
 
     return null_scene();
@@ -16,6 +16,7 @@
 #include "eternal/eternal.hpp"
 #include "ext_workram_data.hpp"
 #include "macrocosmEngine.hpp"
+#include "memory/malloc.hpp"
 #include "platform/flash_filesystem.hpp"
 #include "player/autopilotPlayer.hpp"
 #include "player/opponent/enemyAI.hpp"
@@ -1904,6 +1905,8 @@ BINDING_TABLE({
           scratch_buffer_memory_diagnostics(
               [](const char* line) { info(line); });
           info(format("extension mem: used %", extension_stats().used));
+          info("malloc heap:");
+          malloc_compat::heap_diagnostics([](const char* line) { info(line); });
 
           info("pool diagnostics:");
           info("        name        |   size  |  total  |  used");
@@ -2206,6 +2209,17 @@ BINDING_TABLE({
       [](int argc) {
           return L_INT(flash_filesystem::statistics().bytes_available_);
       }}},
+    {"filesystem-compression",
+     {SIG1(cons, string),
+      [](int argc) {
+          L_EXPECT_OP(0, string);
+          auto path = lisp::get_op0()->string().value();
+          if (auto stats = flash_filesystem::compression_stats(path)) {
+              return L_CONS(L_INT(stats->stored_size_),
+                            L_INT(stats->raw_size_));
+          }
+          return L_NIL;
+      }}},
     {"filesystem-walk",
      {SIG2(nil, string, function),
       [](int argc) {
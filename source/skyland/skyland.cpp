@@ -15,9 +15,11 @@
 #include "graphics/overlay.hpp"
 #include "macrocosmEngine.hpp"
 #include "number/random.hpp"
+#include "platform/conf.hpp"
 #include "platform/flash_filesystem.hpp"
 #include "platform/platform.hpp"
 #include "player/playerP1.hpp"
+#include "profile.hpp"
 #include "room_metatable.hpp"
 #include "save.hpp"
 #include "scene/notificationScene.hpp"
@@ -222,6 +224,22 @@ App::App(bool clean_boot)
     const auto sb = StateBit::remote_console_force_newline;
     state_bit_store(sb, true);
 
+#if not defined(__GBA__) and not defined(__NDS__)
+    // NOTE: The regression tests and the benchmark expect one step per call to
+    // update().
+    auto opt = PLATFORM.get_extensions().has_startup_opt;
+    if (not opt("--regression") and not opt("--bench")) {
+        Conf conf;
+        const char* section = "hardware.desktop";
+        const auto rate = conf.expect<Conf::Integer>(section, "tick_rate");
+        if (rate > 0) {
+            tick_ = seconds(1) / rate;
+        }
+        max_catch_up_ticks_ =
+            conf.expect<Conf::Integer>(section, "max_catch_up_ticks");
+    }
+#endif
+
     info("initialized application...");
 }
 
@@ -402,7 +420,102 @@ static int scratch_buffer_highwater = 0;
 
 
 
+#if not defined(__GBA__) and not defined(__NDS__)
+struct TickPosition
+{
+    Entity* entity_;
+    Vec2<Fixnum> position_;
+};
+
+
+
+// Sprite positions as of the beginning of the latest fixed-step tick, sorted by
+// entity address.
+static Buffer<TickPosition, 1024> tick_positions;
+
+
+
+// The entities that move smoothly enough to be worth interpolating. Characters
+// and rooms move in whole steps anyway.
+template <typename F> static void foreach_interpolated_entity(F&& callback)
+{
+    auto visit = [&](auto& list) {
+        for (auto& e : list) {
+            callback(*e);
+        }
+    };
+
+    visit(APP.effects());
+    visit(APP.birds());
+    visit(APP.player_island().projectiles());
+    APP.with_opponent_island([&](Island& isle) { visit(isle.projectiles()); });
+}
+
+
+
+static void record_tick_positions()
+{
+    tick_positions.clear();
+
+    foreach_interpolated_entity([](Entity& e) {
+        tick_positions.push_back({&e, e.sprite().get_position()});
+    });
+
+    std::sort(tick_positions.begin(),
+              tick_positions.end(),
+              [](const TickPosition& lhs, const TickPosition& rhs) {
+                  return lhs.entity_ < rhs.entity_;
+              });
+}
+#endif
+
+
+
 void App::update(Time delta)
+{
+    PROFILE_ZONE("App::update");
+
+#if not defined(__GBA__) and not defined(__NDS__)
+    // NOTE: We can't run multiplayer games on a fixed step, the peer drives
+    // the clock.
+    if (tick_ and not PLATFORM.network_peer().is_connected()) {
+        tick_accumulator_ += delta;
+
+        int ticks = 0;
+        while (tick_accumulator_ >= tick_) {
+            if (ticks == max_catch_up_ticks_) {
+                // We've fallen too far behind, and running even more ticks per
+                // frame would only make things worse. Drop the backlog and let
+                // the game lag.
+                tick_accumulator_ = 0;
+                break;
+            }
+
+            record_tick_positions();
+
+            // NOTE: Each tick polls input, so that only the first tick of a
+            // frame sees newly pressed keys, and so that frames that run no
+            // ticks at all don't eat keypresses.
+            PLATFORM.input().poll();
+            step(tick_);
+
+            tick_accumulator_ -= tick_;
+            ++ticks;
+        }
+
+        return;
+    }
+
+    tick_accumulator_ = 0;
+#endif
+
+    PLATFORM.input().poll();
+    step(delta);
+}
+
+
+
+void App::step(Time delta)
 {
     const auto previous_rng = rng::critical_state;
     const auto previous_score = score().get();
@@ -480,18 +593,6 @@ void App::update(Time delta)
         }
     }
 
-
-    // if (PLATFORM.input().pressed<Key::select>()) {
-    //     Platform::fatal(format("% % % % % %",
-    //                            t2 - t1,
-    //                            t3 - t2,
-    //                            t4 - t3,
-    //                            t5 - t4,
-    //                            t6 - t5,
-    //                            t7 - t6)
-    //                         .c_str());
-    // }
-
     if (scratch_buffers_in_use() > scratch_buffer_highwater) {
         scratch_buffer_highwater = scratch_buffers_in_use();
 
@@ -586,6 +687,54 @@ void App::render()
         _render_update_scroll();
     }
 
+#if not defined(__GBA__) and not defined(__NDS__)
+    if (tick_accumulator_ and not tick_positions.empty()) {
+        // Draw entities partway between the previous tick and the current
+        // one, according to how far we are into the next tick.
+        const auto alpha =
+            Fixnum::create(Fixnum::scale() / tick_ * tick_accumulator_);
+
+        static Buffer<TickPosition, 1024> restore;
+        restore.clear();
+
+        foreach_interpolated_entity([&](Entity& e) {
+            auto found = std::lower_bound(
+                tick_positions.begin(),
+                tick_positions.end(),
+                &e,
+                [](const TickPosition& p, Entity* e) { return p.entity_ < e; });
+
+            if (found == tick_positions.end() or found->entity_ not_eq &e) {
+                return;
+            }
+
+            const auto current = e.sprite().get_position();
+            const auto motion = current - found->position_;
+
+            // NOTE: An entity destroyed during the tick may have had its
+            // memory reused by a newly spawned one. Don't interpolate across
+            // big jumps.
+            const auto max = Fixnum::from_integer(16);
+            const auto min = Fixnum::from_integer(-16);
+            if (motion.x > max or motion.x < min or motion.y > max or
+                motion.y < min) {
+                return;
+            }
+
+            restore.push_back({&e, current});
+            e.set_sprite_position(found->position_ + motion * alpha);
+        });
+
+        current_scene_->display();
+
+        for (auto& r : restore) {
+            r.entity_->set_sprite_position(r.position_);
+        }
+
+        return;
+    }
+#endif
+
     current_scene_->display();
 }
 
@@ -775,7 +924,7 @@ lisp::Value* App::invoke_script(
         Vector<char> buffer;
         if (flash_filesystem::read_file_data_text(path, buffer)) {
             lisp::VectorCharSequence seq(buffer);
-            auto result = lisp::dostring(seq, *err_handler);
+            auto result = lisp::dostring_cached(seq, *err_handler);
             // In case the script took a bit to execute.
             if (not conf.exclude_delta_) {
                 PLATFORM.delta_clock().reset();
@@ -790,7 +939,7 @@ lisp::Value* App::invoke_script(
 
     if (auto contents = PLATFORM.load_file_contents("", path)) {
         lisp::BasicCharSequence seq(contents);
-        auto result = lisp::dostring(seq, *err_handler);
+        auto result = lisp::dostring_cached(seq, *err_handler);
         if (not conf.exclude_delta_) {
             PLATFORM.delta_clock().reset();
         }
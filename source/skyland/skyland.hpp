@@ -500,6 +500,11 @@ public:
 
 
 private:
+    // Runs one iteration of game logic. update() calls this once per frame, or,
+    // with a fixed tick rate configured, once per elapsed tick.
+    void step(Time delta);
+
+
     // NOTE: As islands take a lot of memory, and App is created on the stack, I
     // ended up moving them into a scratch buffer.
     struct WorldState
@@ -567,6 +572,14 @@ private:
 
     Optional<DynamicMemory<ConsoleState>> console_state_;
 
+#if not defined(__GBA__) and not defined(__NDS__)
+    // Fixed-step simulation, see [hardware.desktop] in boot.ini. A tick_ of
+    // zero runs one step per frame, with the frame's delta.
+    Time tick_ = 0;
+    Time tick_accumulator_ = 0;
+    int max_catch_up_ticks_ = 0;
+#endif
+
 
     ////////////////////////////////////////////////////////////////////////////
     // Fields with two-byte alignment
@@ -38,6 +38,7 @@ enum class StateBit {
     lighting_enabled,
     console_started,
     script_preload_active,
+    benchmark,
     count,
 };
 
@@ -15,6 +15,7 @@
 #include "memory/buffer.hpp"
 #include "number/endian.hpp"
 #include "number/numeric.hpp"
+#include "profile.hpp"
 #include "timeStreamHeader.hpp"
 #include "timeTracker.hpp"
 
@@ -116,6 +117,8 @@ public:
             return;
         }
 
+        PROFILE_ZONE("TimeStream::push");
+
         if (not buffers_) {
             buffers_ = allocate<TimeBuffer>("time-stream", current);
             ++buffer_count_;
@@ -9,12 +9,14 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 
+#include "bench.hpp"
 #include "ext_workram_data.hpp"
 #include "globals.hpp"
 #include "localization.hpp"
 #include "memory/malloc.hpp"
 #include "platform/conf.hpp"
 #include "platform/flash_filesystem.hpp"
+#include "profile.hpp"
 #include "qr.hpp"
 #include "rot13.hpp"
 #include "skyland/achievement.hpp"
@@ -149,12 +151,32 @@ void start(Platform& pfrm)
     }
 
     while (PLATFORM.is_running()) {
-        PLATFORM.input().poll();
-
+        // NOTE: App::update() polls input itself, once per simulation tick.
         PLATFORM_EXTENSION(feed_watchdog);
 
         auto dt = PLATFORM.delta_clock().reset();
-        app->update(dt);
+
+        if (state_bit_load(StateBit::benchmark)) {
+            // NOTE: The benchmark runs headless, as fast as the simulation
+            // allows, so we don't bother rendering anything.
+            app->update(dt);
+            profile::frame_boundary();
+            if (bench::tick(dt)) {
+                bench::report();
+                break;
+            }
+            continue;
+        }
+
+        if (auto overlap = PLATFORM.get_extensions().update_during_present) {
+            Function<4 * sizeof(void*), void()> update([&] {
+                app->update(dt);
+            });
+            overlap(update);
+        } else {
+            app->update(dt);
+        }
+
         PLATFORM.screen().clear();
 
         if (state_bit_load(StateBit::show_fps)) {
@@ -163,6 +185,8 @@ void start(Platform& pfrm)
 
         app->render();
         PLATFORM.screen().display();
+
+        profile::frame_boundary();
     }
 
     app->shutdown();